@@ -44,6 +44,7 @@ function testcase()
     TestMap = require 'TestMap'
     TestArray = require 'TestArray'
     TestActor = require 'TestActor'
+    require 'TestCoroutine'
 
     -- slua can detect dead loop code
     -- if lua exec timeout ,slua will report an error and jump out function 
@@ -27,6 +27,10 @@ end
 print('arr size',arr:Num(),arr:Get(1))
 assert(arr:Get(1)==2028)
 assert(arr:Num()==9)
+assert(#arr==9)
+assert(arr[1]==2028)
+arr[1]=2029
+assert(arr:Get(1)==2029)
 print('array<int> test successful')
 
 -- test array<fstring>
@@ -57,6 +61,17 @@ arr:Add("kyo")
 print('size of arr',arr:Num())
 t:SetArrayStr(arr)
 t:SetArrayStrEx(arr)
+-- plain lua table as TArray param
+t:SetArrayStr({"jamy","valen","kyo"})
+-- move array to param, no element copied
+t:SetArrayStr(arr:Move())
+assert(arr:Num()==0)
+
+-- convert between TArray and lua table
+local arr = slua.ArrayFromTable({1,2,3},EPropertyClass.Int)
+assert(arr:Num()==3 and arr:Get(2)==3)
+local tbl = arr:ToTable()
+assert(#tbl==3 and tbl[1]==1)
 
 local strs = t.strs
 strs:Add("1")
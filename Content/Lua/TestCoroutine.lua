@@ -0,0 +1,41 @@
+local Kismet = import("KismetSystemLibrary")
+
+local co = coroutine.create(function()
+    local t = os.clock()
+    slua.wait(0.5)
+    print("wait 0.5s done", os.clock()-t)
+
+    slua.waitFrames(3)
+    print("wait 3 frames done")
+
+    local ready = false
+    local co2 = coroutine.wrap(function()
+        slua.wait(0.2)
+        ready = true
+    end)
+    co2()
+    slua.waitUntil(function() return ready end)
+    print("wait until ready done")
+
+    -- latent function called in coroutine without LatentInfo is awaited
+    Kismet.Delay(world, 0.5)
+    print("latent delay done")
+
+    -- no latent action registered without world, return at once
+    Kismet.Delay(nil, 0.5)
+    print("latent delay without world returned")
+
+    -- load asynchronously in coroutine and get loaded objects as results
+    local actorClass = slua.loadClassAsync("/Game/TestActor.TestActor")
+    local panel, util = slua.loadObjectAsync({"/Game/Panel.Panel", "/Game/util.util"})
+    print("async loaded", actorClass, panel, util)
+end)
+assert(coroutine.resume(co))
+
+local handle = slua.loadObjectAsync("/Game/Panel.Panel", function(panel)
+    print("async loaded panel", panel)
+end, 100)
+print("async load done", handle:IsDone())
+
+-- wait can't be called out of coroutine
+assert(not pcall(slua.wait, 1))
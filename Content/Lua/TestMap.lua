@@ -56,6 +56,24 @@ local function test()
 	assert(t.maps:Get("age")=="12")
 	mm:Clear()
 	assert(t.maps:Num()==0)
+
+	-- convert between TMap and lua table
+	local map = slua.MapFromTable({name="bill",age="12"},EPropertyClass.Str,EPropertyClass.Str)
+	assert(map:Num()==2 and map:Get("name")=="bill")
+	local tbl = map:ToTable()
+	assert(tbl.age=="12")
+	assert(map:Contains("name") and not map:Contains("sex"))
+	assert(#map:Keys()==2 and #map:Values()==2)
+
+	-- TSet
+	local set = slua.SetFromTable({1,2,3},EPropertyClass.Int)
+	assert(set:Contains(2) and not set:Contains(4))
+	assert(set:Add(4) and not set:Add(4))
+	assert(set:Remove(1) and #set==3)
+	for _,v in pairs(set) do
+		print("set item",v)
+	end
+	assert(#set:ToTable()==3)
 end
 
 TestMap={}
@@ -20,10 +20,9 @@
 
 namespace slua {
 
-    DefTypeName(LuaArray::Enumerator); 
-
     void LuaArray::reg(lua_State* L) {
         SluaUtil::reg(L,"Array",__ctor);
+        SluaUtil::reg(L,"ArrayFromTable",FromTable);
     }
 
     void LuaArray::clone(FScriptArray* destArray, UProperty* p, const FScriptArray* srcArray) {
@@ -37,6 +36,10 @@ namespace slua {
         helper.AddValues(srcArray->Num());
         uint8* dest = helper.GetRawPtr();
         uint8* src = (uint8*)srcArray->GetData();
+        if (p->PropertyFlags & CPF_IsPlainOldData) {
+            FMemory::Memcpy(dest, src, srcArray->Num()*p->ElementSize);
+            return;
+        }
         for(int n=0;n<srcArray->Num();n++) {
             p->CopySingleValue(dest,src);
             dest+=p->ElementSize;
@@ -44,19 +47,25 @@ namespace slua {
         }
     }
 
-	LuaArray::LuaArray(UProperty* p, FScriptArray* buf)
+	LuaArray::LuaArray(UProperty* p, FScriptArray* buf, bool byMove)
 		: inner(p)
 		, prop(nullptr)
 		, propObj(nullptr)
+		, movable(false)
     {
 		array = new FScriptArray();
-		clone(array, p, buf);
+		// take storage of temporary array, no element copied
+		if (byMove && buf)
+			array->MoveAssign(*buf, p->ElementSize);
+		else
+			clone(array, p, buf);
     }
 
 	LuaArray::LuaArray(UArrayProperty* p, UObject* obj)
 		: inner(p->Inner)
 		, prop(p)
 		, propObj(obj)
+		, movable(false)
 	{
 		array = prop->ContainerPtrToValuePtr<FScriptArray>(obj);
 	}
@@ -159,8 +168,20 @@ namespace slua {
 		}
     }
 
-    int LuaArray::push(lua_State* L,UProperty* inner,FScriptArray* data) {
-        LuaArray* luaArrray = new LuaArray(inner,data);
+    void LuaArray::moveOrClone(UProperty* destInner, FScriptArray* dest) {
+        bool move = movable;
+        movable = false;
+        // only array owned by lua can be moved, to an empty dest with same element type
+        if (move && !prop && dest->Num() == 0
+            && destInner->GetClass() == inner->GetClass() && destInner->ElementSize == inner->ElementSize) {
+            dest->MoveAssign(*array, inner->ElementSize);
+            return;
+        }
+        clone(dest, destInner, array);
+    }
+
+    int LuaArray::push(lua_State* L,UProperty* inner,FScriptArray* data,bool byMove) {
+        LuaArray* luaArrray = new LuaArray(inner,data,byMove);
 		return LuaObject::pushType(L,luaArrray,"LuaArray",setupMT,gc);
     }
 
@@ -179,7 +200,52 @@ namespace slua {
         if(type==EPropertyClass::Object && !cls)
             luaL_error(L,"Array of UObject should have secend parameter is UClass");
 		auto array = FScriptArray();
-		return push(L, PropertyProto::createProperty({ type, cls }), &array);
+		return push(L, PropertyProto::getProperty({ type, cls }), &array);
+    }
+
+    void LuaArray::fillFromTable(lua_State* L, int p, UProperty* inner, FScriptArray* array) {
+        p = lua_absindex(L, p);
+        auto checker = LuaObject::getChecker(inner);
+        if (!checker) {
+            FString tn = inner->GetClass()->GetName();
+            luaL_error(L, "unsupport array element type %s", TCHAR_TO_UTF8(*tn));
+        }
+        int n = (int)lua_rawlen(L, p);
+        if (n == 0) return;
+        FScriptArrayHelper helper = FScriptArrayHelper::CreateHelperFormInnerProperty(inner, array);
+        int start = helper.AddValues(n);
+        for (int i = 0; i < n; i++) {
+            lua_rawgeti(L, p, i + 1);
+            checker(L, inner, helper.GetRawPtr(start + i), lua_gettop(L));
+            lua_pop(L, 1);
+        }
+    }
+
+    // slua.ArrayFromTable(t,type[,cls]), create array from lua table in one call
+    int LuaArray::FromTable(lua_State* L) {
+        luaL_checktype(L, 1, LUA_TTABLE);
+        auto type = (EPropertyClass)LuaObject::checkValue<int>(L, 2);
+        auto cls = LuaObject::checkValueOpt<UClass*>(L, 3, nullptr);
+        if (type == EPropertyClass::Object && !cls)
+            luaL_error(L, "Array of UObject should have third parameter is UClass");
+        auto inner = PropertyProto::getProperty({ type, cls });
+        if (!inner)
+            luaL_error(L, "unsupport array element type %d", (int)type);
+        LuaArray* luaArray = new LuaArray(inner, nullptr);
+        LuaObject::pushType(L, luaArray, "LuaArray", setupMT, gc);
+        fillFromTable(L, 1, inner, luaArray->array);
+        return 1;
+    }
+
+    int LuaArray::ToTable(lua_State* L) {
+        CheckUD(LuaArray, L, 1);
+        int n = UD->num();
+        lua_createtable(L, n, 0);
+        for (int i = 0; i < n; i++) {
+            LuaObject::push(L, UD->inner, UD->getRawPtr(i));
+            lua_rawseti(L, -2, i + 1);
+        }
+        return 1;
     }
 
     int LuaArray::Num(lua_State* L) {
@@ -268,38 +334,63 @@ namespace slua {
 		return 0;
     }
 
+    // arr:Move(), mark array to be moved to next ufunction param instead of copied,
+    // array will be empty after that call, return self
+    int LuaArray::Move(lua_State* L) {
+        CheckUD(LuaArray,L,1);
+        UD->movable = true;
+        lua_pushvalue(L,1);
+        return 1;
+    }
+
     int LuaArray::Clear(lua_State* L) {
         CheckUD(LuaArray,L,1);
         UD->clear();
 		return 0;
     }
 
+	// stateless iterator, control variable is index of array
+	// so nothing allocated for each loop
 	int LuaArray::Pairs(lua_State* L) {
 		CheckUD(LuaArray, L, 1);
-		auto iter = new LuaArray::Enumerator();
-		iter->arr = UD;
-		iter->index = 0;
 		lua_pushcfunction(L, LuaArray::Enumerable);
-		LuaObject::pushType(L, iter, "LuaArray::Enumerator", nullptr, LuaArray::Enumerator::gc);
+		lua_pushvalue(L, 1);
 		LuaObject::pushNil(L);
 		return 3;
 	}
 
 	int LuaArray::Enumerable(lua_State* L) {
-		CheckUD(LuaArray::Enumerator, L, 1);
-		auto arr = UD->arr;
-		if (arr->isValidIndex(UD->index)) {
-			auto element = arr->inner;
-			auto es = element->ElementSize;
-			auto parms = ((uint8*)arr->array->GetData()) + UD->index * es;
-			LuaObject::push(L, UD->index);
-			LuaObject::push(L, element, parms);
-			UD->index += 1;
+		CheckUD(LuaArray, L, 1);
+		int index = lua_isnil(L, 2) ? 0 : LuaObject::checkValue<int>(L, 2) + 1;
+		if (UD->isValidIndex(index)) {
+			LuaObject::push(L, index);
+			LuaObject::push(L, UD->inner, UD->getRawPtr(index));
 			return 2;
 		} 
 		return 0;
 	}
 
+	// arr[i] get element by integer index, otherwise search member function
+	int LuaArray::__index(lua_State* L) {
+		if (lua_isinteger(L, 2))
+			return Get(L);
+		lua_getmetatable(L, 1);
+		lua_pushvalue(L, 2);
+		lua_rawget(L, -2);
+		lua_remove(L, -2); // remove mt of ud
+		return 1;
+	}
+
+	int LuaArray::__newindex(lua_State* L) {
+		if (!lua_isinteger(L, 2))
+			luaL_error(L, "Array only accept integer index to set");
+		return Set(L);
+	}
+
+	int LuaArray::__len(lua_State* L) {
+		return Num(L);
+	}
+
     int LuaArray::setupMT(lua_State* L) {
         LuaObject::setupMTSelfSearch(L);
 
@@ -311,8 +402,13 @@ namespace slua {
         RegMetaMethod(L,Insert);
         RegMetaMethod(L,Remove);
         RegMetaMethod(L,Clear);
+        RegMetaMethod(L,Move);
+        RegMetaMethod(L,ToTable);
 
 		RegMetaMethodByName(L, "__pairs", Pairs);
+		RegMetaMethodByName(L, "__len", __len);
+		RegMetaMethodByName(L, "__index", __index);
+		RegMetaMethodByName(L, "__newindex", __newindex);
 
         return 0;
     }
@@ -323,10 +419,4 @@ namespace slua {
         return 0;   
     }
 
-	int LuaArray::Enumerator::gc(lua_State* L) {
-		CheckUD(LuaArray::Enumerator, L, 1);
-		delete UD;
-		return 0;
-	}
-
 }
\ No newline at end of file
@@ -0,0 +1,265 @@
+// Tencent is pleased to support the open source community by making sluaunreal available.
+
+// Copyright (C) 2018 THL A29 Limited, a Tencent company. All rights reserved.
+// Licensed under the BSD 3-Clause License (the "License");
+// you may not use this file except in compliance with the License. You may obtain a copy of the License at
+
+// https://opensource.org/licenses/BSD-3-Clause
+
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and limitations under the License.
+
+#include "LuaAsyncLoader.h"
+#include "LuaState.h"
+#include "LuaObject.h"
+#include "LuaCoroutine.h"
+#include "SluaLib.h"
+#include "Engine/StreamableManager.h"
+#include "Engine/AssetManager.h"
+#include "Blueprint/UserWidget.h"
+#include "Misc/PackageName.h"
+
+namespace slua {
+
+	namespace {
+		enum class LoadKind {
+			Object,
+			Class,
+			UI,
+		};
+
+		class LuaAsyncLoad {
+		public:
+			LuaStateHandle stateHandle;
+			LoadKind kind = LoadKind::Object;
+			TArray<FSoftObjectPath> paths;
+			// owner of widgets created by loadUIAsync
+			TWeakObjectPtr<UObject> owner;
+			// ref of callback, or of coroutine waiting for loading if isThread
+			int ref = LUA_NOREF;
+			bool isThread = false;
+			bool done = false;
+			// keep loaded objects alive until pushed to lua
+			TSharedPtr<FStreamableHandle> handle;
+
+			bool isLoaded() const {
+				for (auto& path : paths) {
+					if (!path.ResolveObject()) return false;
+				}
+				return true;
+			}
+
+			// push loaded objects in order of paths, nil for failed path
+			int pushResults(lua_State* L) {
+				luaL_checkstack(L, paths.Num(), "too many paths to load");
+				for (auto& path : paths) {
+					UObject* obj = path.ResolveObject();
+					if (kind == LoadKind::Class)
+						LuaObject::pushClass(L, Cast<UClass>(obj));
+					else if (kind == LoadKind::UI) {
+						UClass* cls = Cast<UClass>(obj);
+						LuaObject::push(L, cls ? SluaUtil::createWidget(L, cls, owner.Get()) : nullptr);
+					}
+					else
+						LuaObject::push(L, obj);
+				}
+				return paths.Num();
+			}
+
+			static int callCallback(lua_State* L) {
+				auto load = (LuaAsyncLoad*)lua_touserdata(L, 1);
+				lua_rawgeti(L, LUA_REGISTRYINDEX, load->ref);
+				int n = load->pushResults(L);
+				lua_call(L, n, 0);
+				return 0;
+			}
+
+			void complete() {
+				if (done) return;
+				done = true;
+				LuaState* ls = stateHandle.get();
+				if (!ls) {
+					handle.Reset();
+					return;
+				}
+				// objects are pushed when coroutine resumed
+				if (isThread) {
+					ls->coroutineScheduler()->wake(ref);
+					ref = LUA_NOREF;
+					return;
+				}
+
+				lua_State* L = ls->getLuaState();
+				int top = lua_gettop(L);
+				int errfunc = LuaState::pushErrorHandler(L);
+				lua_pushcfunction(L, callCallback);
+				lua_pushlightuserdata(L, this);
+				{
+					LuaScriptCallGuard g(L);
+					lua_pcall(L, 1, 0, errfunc);
+				}
+				lua_settop(L, top);
+				luaL_unref(L, LUA_REGISTRYINDEX, ref);
+				ref = LUA_NOREF;
+				handle.Reset();
+			}
+
+			void cancel() {
+				if (done) return;
+				done = true;
+				if (handle.IsValid()) {
+					handle->CancelHandle();
+					handle.Reset();
+				}
+				LuaState* ls = stateHandle.get();
+				if (ls) luaL_unref(ls->getLuaState(), LUA_REGISTRYINDEX, ref);
+				ref = LUA_NOREF;
+			}
+		};
+
+		// userdata returned to lua, loading go on after it collected
+		struct LuaAsyncLoadHandle {
+			TSharedPtr<LuaAsyncLoad> load;
+		};
+	}
+
+	DefTypeName(LuaAsyncLoadHandle);
+
+	namespace {
+		int Cancel(lua_State* L) {
+			CheckUD(LuaAsyncLoadHandle, L, 1);
+			UD->load->cancel();
+			return 0;
+		}
+
+		int IsDone(lua_State* L) {
+			CheckUD(LuaAsyncLoadHandle, L, 1);
+			return LuaObject::push(L, UD->load->done);
+		}
+
+		int gc(lua_State* L) {
+			CheckUD(LuaAsyncLoadHandle, L, 1);
+			delete UD;
+			return 0;
+		}
+
+		int setupMT(lua_State* L) {
+			LuaObject::setupMTSelfSearch(L);
+			RegMetaMethod(L, Cancel);
+			RegMetaMethod(L, IsDone);
+			return 0;
+		}
+
+		int pushHandle(lua_State* L, const TSharedPtr<LuaAsyncLoad>& load) {
+			auto ud = new LuaAsyncLoadHandle{ load };
+			return LuaObject::pushType(L, ud, "LuaAsyncLoadHandle", setupMT, gc);
+		}
+
+		// read path or array of paths at p
+		void checkPaths(lua_State* L, int p, LoadKind kind, TArray<FSoftObjectPath>& paths) {
+			auto addPath = [&](const char* str) {
+				FString path = kind == LoadKind::Object ? FString(UTF8_TO_TCHAR(str)) : SluaUtil::getClassPath(str);
+				paths.Add(FSoftObjectPath(FPackageName::ExportTextPathToObjectPath(path)));
+			};
+			if (!lua_istable(L, p)) {
+				addPath(luaL_checkstring(L, p));
+				return;
+			}
+			int n = (int)lua_rawlen(L, p);
+			for (int i = 1; i <= n; i++) {
+				lua_rawgeti(L, p, i);
+				const char* str = lua_tostring(L, -1);
+				if (!str) luaL_error(L, "expect string at index %d of paths", i);
+				addPath(str);
+				lua_pop(L, 1);
+			}
+			if (n == 0) luaL_error(L, "paths is empty");
+		}
+
+		// coroutine resumed after loading completed, handle of load is at ctx
+		int continueLoad(lua_State* L, int status, lua_KContext ctx) {
+			CheckUD(LuaAsyncLoadHandle, L, (int)ctx);
+			int n = UD->load->pushResults(L);
+			UD->load->handle.Reset();
+			return n;
+		}
+
+		int loadAsync(lua_State* L, LoadKind kind, const char* fn) {
+			TSharedPtr<LuaAsyncLoad> load = MakeShared<LuaAsyncLoad>();
+			load->kind = kind;
+			checkPaths(L, 1, kind, load->paths);
+			int cb = 2;
+			if (kind == LoadKind::UI) {
+				load->owner = LuaObject::checkValueOpt<UObject*>(L, 2, nullptr);
+				cb = 3;
+			}
+			auto priority = (TAsyncLoadPriority)luaL_optinteger(L, cb + 1, FStreamableManager::DefaultAsyncLoadPriority);
+			bool hasCallback = !lua_isnoneornil(L, cb);
+			if (hasCallback)
+				luaL_checktype(L, cb, LUA_TFUNCTION);
+			else if (!lua_isyieldable(L))
+				luaL_error(L, "%s without callback must be called in coroutine", fn);
+
+			// resolve loaded objects immediately
+			if (load->isLoaded()) {
+				load->done = true;
+				if (!hasCallback)
+					return load->pushResults(L);
+				lua_pushvalue(L, cb);
+				lua_call(L, load->pushResults(L), 0);
+				return pushHandle(L, load);
+			}
+
+			LuaState* ls = LuaState::get(L);
+			load->stateHandle = ls->handle();
+			if (hasCallback) {
+				lua_pushvalue(L, cb);
+				load->ref = luaL_ref(L, LUA_REGISTRYINDEX);
+			}
+			else {
+				load->ref = ls->coroutineScheduler()->suspend(L, fn);
+				load->isThread = true;
+			}
+
+			load->handle = LuaAsyncLoader::getStreamableManager().RequestAsyncLoad(load->paths,
+				FStreamableDelegate::CreateLambda([load]() { load->complete(); }), priority);
+			// no valid path to load
+			if (!load->handle.IsValid())
+				load->complete();
+
+			pushHandle(L, load);
+			if (load->isThread)
+				return lua_yieldk(L, 0, (lua_KContext)lua_gettop(L), continueLoad);
+			return 1;
+		}
+
+		int loadObjectAsync(lua_State* L) {
+			return loadAsync(L, LoadKind::Object, "loadObjectAsync");
+		}
+
+		int loadClassAsync(lua_State* L) {
+			return loadAsync(L, LoadKind::Class, "loadClassAsync");
+		}
+
+		int loadUIAsync(lua_State* L) {
+			return loadAsync(L, LoadKind::UI, "loadUIAsync");
+		}
+	}
+
+	void LuaAsyncLoader::reg(lua_State* L)
+	{
+		SluaUtil::reg(L, "loadObjectAsync", loadObjectAsync);
+		SluaUtil::reg(L, "loadClassAsync", loadClassAsync);
+		SluaUtil::reg(L, "loadUIAsync", loadUIAsync);
+	}
+
+	FStreamableManager& LuaAsyncLoader::getStreamableManager()
+	{
+		if (UAssetManager::IsValid())
+			return UAssetManager::GetStreamableManager();
+		static FStreamableManager manager;
+		return manager;
+	}
+}
@@ -13,10 +13,17 @@
 
 
 #include "LuaBase.h"
+#include "LuaTickManager.h"
+#include "Engine/World.h"
+#include "GameFramework/Actor.h"
+#include "GameFramework/PlayerController.h"
 
 namespace slua {
 
-	slua::LuaVar LuaBase::metaTable;
+	namespace {
+		typedef TPair<LuaStateSlot*, FString> ClassModuleKey;
+		TMap<ClassModuleKey, TUniquePtr<LuaClassModule>> classModules;
+	}
 
 	struct UFunctionParamScope {
 		LuaBase* pBase;
@@ -36,89 +43,402 @@ namespace slua {
 		}
 	};
 
+	LuaBase::~LuaBase()
+	{
+		removeFromTickManager();
+		// lua table may live longer than us
+		if (luaSelfTable.isValid() && luaSelfTable.isTable()) {
+			auto L = luaSelfTable.getState();
+			luaSelfTable.push(L);
+			lua_pushnil(L);
+			lua_setfield(L, -2, SLUA_LUABASE);
+			lua_pop(L, 1);
+		}
+	}
+
 	bool LuaBase::luaImplemented(UFunction * func, void * params)
 	{
 		if (!func->HasAnyFunctionFlags(EFunctionFlags::FUNC_BlueprintEvent))
 			return false;
 
-		if (!luaSelfTable.isTable())
+		if (!overrides.IsValid() || !luaSelfTable.isValid() || !luaSelfTable.isTable())
 			return false;
 
-		slua::LuaVar lfunc = luaSelfTable.getFromTable<slua::LuaVar>((const char*)TCHAR_TO_UTF8(*func->GetName()), true);
-		if (!lfunc.isValid()) return false;
+		// hold map during call, class module may be freed by lua
+		TSharedPtr<LuaOverrideMap> current = overrides;
+		LuaEventOverride* entry = current->Find(func);
+		if (!entry) return false;
+
+		// function set to self table shadows class table
+		slua::LuaVar* lfunc = selfOverrides.Find(func);
+		if (!lfunc) {
+			auto L = luaClassTable.getState();
+			AutoStack as(L);
+			// class table may be assigned after collected, refresh entry if function changed
+			luaClassTable.push(L);
+			entry->name.push(L);
+			lua_gettable(L, -2);
+			entry->func.push(L);
+			if (!lua_rawequal(L, -1, -2)) {
+				if (lua_isfunction(L, -2))
+					entry->func.set(L, -2);
+				else
+					entry->func.free();
+			}
+			if (entry->func.isNil())
+				return false;
+			lfunc = &entry->func;
+		}
 
 		UFunctionParamScope scope(this, func, params);
-		return lfunc.callByUFunction(func, (uint8*)params, &luaSelfTable);
+		return lfunc->callByUFunction(func, (uint8*)params, &luaSelfTable);
+	}
+
+	LuaClassModule* LuaBase::loadClassModule(LuaState* ls, const FString& luaPath)
+	{
+		ClassModuleKey key(ls->handle().slot, luaPath);
+		if (auto module = classModules.Find(key)) {
+			// slot may be reused by a new state
+			if ((*module)->classTable.isValid())
+				return module->Get();
+			classModules.Remove(key);
+		}
+
+		slua::LuaVar classTable = ls->doFile(TCHAR_TO_UTF8(*luaPath));
+		if (!classTable.isTable())
+			return nullptr;
+
+		auto module = new LuaClassModule();
+		module->classTable = classTable;
+		classModules.Add(key, TUniquePtr<LuaClassModule>(module));
+		return module;
+	}
+
+	void LuaBase::removeClassModules(LuaState* ls)
+	{
+		LuaStateSlot* slot = ls->handle().slot;
+		for (auto it = classModules.CreateIterator(); it; ++it)
+			if (it.Key().Key == slot)
+				it.RemoveCurrent();
+	}
+
+	TSharedPtr<LuaOverrideMap> LuaBase::collectOverrides(UClass* cls, const LuaVar& classTable)
+	{
+		TSharedPtr<LuaOverrideMap> result = MakeShareable(new LuaOverrideMap());
+		if (!cls || !classTable.isTable())
+			return result;
+
+		auto L = classTable.getState();
+		classTable.push(L);
+		for (TFieldIterator<UFunction> it(cls, EFieldIteratorFlags::IncludeSuper,
+			EFieldIteratorFlags::ExcludeDeprecated, EFieldIteratorFlags::IncludeInterfaces); it; ++it) {
+			UFunction* func = *it;
+			if (!func->HasAnyFunctionFlags(EFunctionFlags::FUNC_BlueprintEvent))
+				continue;
+			// every event is added, so function assigned to class table later can be found
+			LuaEventOverride& entry = result->Add(func);
+			lua_pushstring(L, TCHAR_TO_UTF8(*func->GetName()));
+			entry.name.set(L, -1);
+			lua_gettable(L, -2);
+			if (lua_isfunction(L, -1))
+				entry.func.set(L, -1);
+			lua_pop(L, 1);
+		}
+		lua_pop(L, 1);
+		return result;
+	}
+
+	void LuaBase::pushMember(lua_State* L, const char* name, bool rawget)
+	{
+		luaSelfTable.push(L);
+		if (rawget) {
+			lua_pushstring(L, name);
+			lua_rawget(L, -2);
+			if (lua_isnil(L, -1)) {
+				lua_pop(L, 1);
+				luaClassTable.push(L);
+				lua_getfield(L, -1, name);
+				lua_remove(L, -2);
+			}
+		}
+		else
+			lua_getfield(L, -1, name);
+		lua_remove(L, -2);
+	}
+
+	bool LuaBase::addToTickManager(UWorld* world, ETickingGroup group)
+	{
+		if (!luaSelfTable.isTable() || !tickFunction.isFunction())
+			return false;
+
+		auto L = luaSelfTable.getState();
+		pushMember(L, "bBatchTick", true);
+		bool batchTick = !!lua_toboolean(L, -1);
+		lua_pop(L, 1);
+		if (!batchTick)
+			return false;
+
+		pushMember(L, "TickInterval", true);
+		float interval = (float)lua_tonumber(L, -1);
+		lua_pop(L, 1);
+
+		auto manager = LuaTickManager::get(LuaState::get(L), world, group);
+		if (!manager)
+			return false;
+		manager->add(this, interval);
+		return true;
+	}
+
+	void LuaBase::removeFromTickManager()
+	{
+		if (tickManager) tickManager->remove(this);
+	}
+
+	const int LuaTickLOD::FrameDivisor[LuaTickLOD::BucketCount] = { 1, 2, 4, 10 };
+	const float LuaTickLOD::MinSignificance[LuaTickLOD::BucketCount] = { 0.75f, 0.5f, 0.25f, 0.0f };
+
+	int LuaTickLOD::bucketOf(float significance)
+	{
+		for (int i = 0; i < BucketCount - 1; i++) {
+			if (significance >= MinSignificance[i])
+				return i;
+		}
+		return BucketCount - 1;
+	}
+
+	void LuaBase::initTickLOD(AActor* actor)
+	{
+		static int lodSerial = 0;
+		lodActor = actor;
+		tickLOD = LuaTickLOD();
+		if (!luaSelfTable.isTable())
+			return;
+
+		auto L = luaSelfTable.getState();
+		pushMember(L, "GetTickSignificance", true);
+		if (lua_isfunction(L, -1))
+			tickLOD.significanceFunc.set(L, -1);
+		lua_pop(L, 1);
+		pushMember(L, "TickLODDistance", true);
+		tickLOD.distance = (float)lua_tonumber(L, -1);
+		lua_pop(L, 1);
+
+		tickLOD.enabled = tickLOD.significanceFunc.isFunction() || (lodActor && tickLOD.distance > 0);
+		// stagger actors in same bucket across frames
+		tickLOD.frame = lodSerial++;
+	}
+
+	float LuaBase::tickSignificance()
+	{
+		if (tickLOD.significanceFunc.isFunction())
+			return tickLOD.significanceFunc.call(luaSelfTable).castTo<float>();
+
+		UWorld* world = lodActor ? lodActor->GetWorld() : nullptr;
+		if (!world) return 1.0f;
+		FVector location = lodActor->GetActorLocation();
+		float minDistSq = MAX_flt;
+		for (auto it = world->GetPlayerControllerIterator(); it; ++it) {
+			APlayerController* pc = it->Get();
+			if (!pc) continue;
+			FVector viewLocation;
+			FRotator viewRotation;
+			pc->GetPlayerViewPoint(viewLocation, viewRotation);
+			minDistSq = FMath::Min(minDistSq, (float)FVector::DistSquared(location, viewLocation));
+		}
+		// no viewer, keep full rate
+		if (minDistSq == MAX_flt) return 1.0f;
+		return 1.0f - FMath::Clamp(FMath::Sqrt(minDistSq) / tickLOD.distance, 0.0f, 1.0f);
+	}
+
+	bool LuaBase::stepTickLOD(float DeltaTime, float& outDeltaTime)
+	{
+		if (!tickLOD.enabled) {
+			outDeltaTime = DeltaTime;
+			return true;
+		}
+		tickLOD.accum += DeltaTime;
+		tickLOD.frame++;
+		if (tickLOD.frame % LuaTickLOD::FrameDivisor[tickLOD.bucket] != 0)
+			return false;
+
+		outDeltaTime = tickLOD.accum;
+		tickLOD.accum = 0;
+		// pick bucket for next ticks
+		tickLOD.bucket = LuaTickLOD::bucketOf(tickSignificance());
+		return true;
 	}
 
 	// Called every frame
 	void LuaBase::tick(float DeltaTime)
 	{
-		UFunctionParamScope scope(this, UFUNCTION_TICK, DeltaTime);
 		if (!tickFunction.isValid()) {
+			UFunctionParamScope scope(this, UFUNCTION_TICK, DeltaTime);
 			superTick();
 			return;
 		}
-		tickFunction.call(luaSelfTable, DeltaTime);
-		// try lua gc
-		lua_gc(tickFunction.getState(), LUA_GCSTEP, 128);
+		float dt;
+		if (!stepTickLOD(DeltaTime, dt))
+			return;
+		UFunctionParamScope scope(this, UFUNCTION_TICK, dt);
+		tickFunction.call(luaSelfTable, dt);
+	}
+
+	namespace {
+		// upvalues of __index and __newindex
+		const int ClassTableUpvalue = 1;
+		const int FieldCacheUpvalue = 2;
+		const int UClassUpvalue = 3;
+
+		// push UObject of self table at 1
+		UObject* checkCppInst(lua_State* L) {
+			lua_pushstring(L, SLUA_CPPINST);
+			lua_rawget(L, 1);
+			if (!lua_isuserdata(L, -1))
+				luaL_error(L, "expect LuaBase table at arg 1");
+			return LuaObject::checkValue<UObject*>(L, -1);
+		}
+
+		// push how string key at 2 forward to cpp instance, cached in field cache:
+		// lightuserdata of UProperty for engine property,
+		// function for engine function or extension method,
+		// false for lua field
+		void pushFieldKind(lua_State* L) {
+			lua_pushvalue(L, 2);
+			lua_rawget(L, lua_upvalueindex(FieldCacheUpvalue));
+			if (!lua_isnil(L, -1))
+				return;
+			lua_pop(L, 1);
+
+			UClass* cls = (UClass*)lua_touserdata(L, lua_upvalueindex(UClassUpvalue));
+			const char* name = lua_tostring(L, 2);
+			FName wname(UTF8_TO_TCHAR(name));
+			if (UFunction* func = cls->FindFunctionByName(wname))
+				LuaObject::push(L, func);
+			else if (UProperty* up = cls->FindPropertyByName(wname))
+				lua_pushlightuserdata(L, up);
+			else {
+				// search extension method by cpp instance
+				checkCppInst(L);
+				lua_pushvalue(L, 2);
+				lua_gettable(L, -2);
+				lua_remove(L, -2);
+				if (!lua_isfunction(L, -1)) {
+					lua_pop(L, 1);
+					lua_pushboolean(L, false);
+				}
+			}
+			lua_pushvalue(L, 2);
+			lua_pushvalue(L, -2);
+			lua_rawset(L, lua_upvalueindex(FieldCacheUpvalue));
+		}
 	}
 
 	int LuaBase::__index(slua::lua_State * L)
 	{
-		lua_pushstring(L, SLUA_CPPINST);
-		lua_rawget(L, 1);
-		if (!lua_isuserdata(L, -1))
-			luaL_error(L, "expect LuaBase table at arg 1");
-		// push key
+		// search class table first
 		lua_pushvalue(L, 2);
-		// get field from real actor
-		lua_gettable(L, -2);
-		return 1;
-	}
+		lua_gettable(L, lua_upvalueindex(ClassTableUpvalue));
+		if (!lua_isnil(L, -1))
+			return 1;
+		lua_pop(L, 1);
 
-	static int setParent(slua::lua_State* L) {
-		// set field to obj, may raise an error
-		lua_settable(L, 1);
-		return 0;
+		if (lua_type(L, 2) != LUA_TSTRING) {
+			checkCppInst(L);
+			lua_pushvalue(L, 2);
+			lua_gettable(L, -2);
+			return 1;
+		}
+
+		pushFieldKind(L);
+		if (lua_islightuserdata(L, -1)) {
+			UProperty* up = (UProperty*)lua_touserdata(L, -1);
+			return LuaObject::push(L, up, checkCppInst(L));
+		}
+		// engine function or extension method
+		if (lua_isfunction(L, -1))
+			return 1;
+		// lua field not set yet
+		lua_pushnil(L);
+		return 1;
 	}
 
 	int LuaBase::__newindex(slua::lua_State * L)
 	{
-		lua_pushstring(L, SLUA_CPPINST);
-		lua_rawget(L, 1);
-		if (!lua_isuserdata(L, -1))
-			luaL_error(L, "expect LuaBase table at arg 1");
+		UFunction* event = nullptr;
+		if (lua_type(L, 2) == LUA_TSTRING) {
+			pushFieldKind(L);
+			if (lua_islightuserdata(L, -1)) {
+				UProperty* up = (UProperty*)lua_touserdata(L, -1);
+				auto checker = LuaObject::getChecker(up);
+				// readonly or unsupported property is shadowed by lua field
+				if (checker && !(up->GetPropertyFlags() & CPF_BlueprintReadOnly)) {
+					UObject* obj = checkCppInst(L);
+					checker(L, up, up->ContainerPtrToValuePtr<uint8>(obj), 3);
+					return 0;
+				}
+			}
+			// engine function, field may override blueprint event
+			else if (lua_isfunction(L, -1)) {
+				UClass* cls = (UClass*)lua_touserdata(L, lua_upvalueindex(UClassUpvalue));
+				UFunction* func = cls->FindFunctionByName(FName(UTF8_TO_TCHAR(lua_tostring(L, 2))));
+				if (func && func->HasAnyFunctionFlags(EFunctionFlags::FUNC_BlueprintEvent))
+					event = func;
+			}
+			lua_pop(L, 1);
+		}
 
-		lua_pushcfunction(L, setParent);
-		// push cpp inst
-		lua_pushvalue(L, -2);
-		// push key
-		lua_pushvalue(L, 2);
-		// push value
-		lua_pushvalue(L, 3);
-		// set ok?
-		if (lua_pcall(L, 3, 0, 0)) {
+		// only update override of this event
+		if (event) {
+			lua_getfield(L, 1, SLUA_LUABASE);
+			LuaBase* base = (LuaBase*)lua_touserdata(L, -1);
 			lua_pop(L, 1);
-			// push key
-			lua_pushvalue(L, 2);
-			// push value
-			lua_pushvalue(L, 3);
-			// rawset to table
-			lua_rawset(L, 1);
+			if (base) {
+				if (lua_isfunction(L, 3))
+					base->selfOverrides.Add(event, slua::LuaVar(L, 3));
+				else
+					base->selfOverrides.Remove(event);
+			}
 		}
+
+		lua_settop(L, 3);
+		lua_rawset(L, 1);
 		return 0;
 	}
 
+	void LuaBase::pushInstanceMT(lua_State* L, LuaClassModule* module, UClass* cls)
+	{
+		auto mt = module->metaTables.Find(cls);
+		if (mt && mt->isValid()) {
+			mt->push(L);
+			return;
+		}
+
+		lua_newtable(L);
+		module->classTable.push(L);
+		lua_newtable(L);
+		lua_pushlightuserdata(L, cls);
+		// share upvalues between __index and __newindex
+		lua_pushvalue(L, -3);
+		lua_pushvalue(L, -3);
+		lua_pushvalue(L, -3);
+		lua_pushcclosure(L, __index, 3);
+		lua_setfield(L, -5, "__index");
+		lua_pushcclosure(L, __newindex, 3);
+		lua_setfield(L, -2, "__newindex");
+		module->metaTables.Add(cls, LuaVar(L, -1));
+	}
+
 	LuaVar LuaBase::callMember(FString func, const TArray<FLuaBPVar>& args)
 	{
-		slua::LuaVar lfunc = luaSelfTable.getFromTable<slua::LuaVar>((const char*)TCHAR_TO_UTF8(*func), true);
+		auto L = luaSelfTable.getState();
+		pushMember(L, TCHAR_TO_UTF8(*func), true);
+		slua::LuaVar lfunc(L, -1);
+		lua_pop(L, 1);
 		if (!lfunc.isFunction()) {
 			Log::Error("Can't find lua member function named %s to call", TCHAR_TO_UTF8(*func));
 			return false;
 		}
 		
-		auto L = luaSelfTable.getState();
 		// push self
 		luaSelfTable.push(L);
 		// push arg to lua
@@ -133,10 +453,15 @@ namespace slua {
 		if (!luaSelfTable.isTable())
 			return false;
 
-		bool tickEnabled = luaSelfTable.getFromTable<bool>(tickFlag, rawget);
+		auto L = luaSelfTable.getState();
+		pushMember(L, tickFlag, rawget);
+		bool tickEnabled = !!lua_toboolean(L, -1);
+		lua_pop(L, 1);
 
-		if (tickEnabled && luaSelfTable.isTable()) {
-			tickFunction = luaSelfTable.getFromTable<slua::LuaVar>("Tick", true);
+		if (tickEnabled) {
+			pushMember(L, "Tick", true);
+			tickFunction.set(L, -1);
+			lua_pop(L, 1);
 			return tickEnabled;
 		}
 		return false;
@@ -52,7 +52,7 @@ FLuaBPVar ULuaBlueprintLibrary::CallToLuaWithArgs(FString funcname,const TArray<
     auto ls = LuaState::get();
     if(StateName.Len()!=0) ls = LuaState::get(StateName);
     if(!ls) return FLuaBPVar();
-    LuaVar f = ls->get(TCHAR_TO_UTF8(*funcname));
+    LuaVar f = ls->resolve(funcname);
     if(!f.isFunction()) {
 		Log::Error("Can't find lua member function named %s to call", TCHAR_TO_UTF8(*funcname));
         return LuaVar();
@@ -70,7 +70,7 @@ FLuaBPVar ULuaBlueprintLibrary::CallToLua(FString funcname,FString StateName) {
     auto ls = LuaState::get();
     if(StateName.Len()!=0) ls = LuaState::get(StateName);
     if(!ls) return FLuaBPVar();
-    LuaVar f = ls->get(TCHAR_TO_UTF8(*funcname));
+    LuaVar f = ls->resolve(funcname);
 	if (!f.isFunction()) {
 		Log::Error("Can't find lua member function named %s to call", TCHAR_TO_UTF8(*funcname));
         return LuaVar();
@@ -0,0 +1,146 @@
+// Tencent is pleased to support the open source community by making sluaunreal available.
+
+// Copyright (C) 2018 THL A29 Limited, a Tencent company. All rights reserved.
+// Licensed under the BSD 3-Clause License (the "License");
+// you may not use this file except in compliance with the License. You may obtain a copy of the License at
+
+// https://opensource.org/licenses/BSD-3-Clause
+
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and limitations under the License.
+
+#include "LuaBytecodeCache.h"
+#include "Log.h"
+#include "Misc/Paths.h"
+#include "Misc/FileHelper.h"
+#include "Misc/SecureHash.h"
+#include "HAL/FileManager.h"
+
+namespace slua {
+
+	namespace {
+		// bytecode can only be loaded by vm with same version and type sizes
+		struct VMBuildId {
+			char id[64];
+			VMBuildId() {
+				snprintf(id, sizeof(id), "%s-%d-%d-%d-%d", LUA_VERSION, (int)sizeof(size_t),
+					(int)sizeof(lua_Integer), (int)sizeof(lua_Number), (int)sizeof(int));
+			}
+		};
+
+		// called by preload workers, local static is initialized once thread safe
+		const char* vmBuildId() {
+			static const VMBuildId buildId;
+			return buildId.id;
+		}
+
+		int writer(lua_State* L, const void* p, size_t sz, void* ud) {
+			((TArray<uint8>*)ud)->Append((const uint8*)p, sz);
+			return 0;
+		}
+
+		bool isBytecode(const uint8* buf, uint32 len) {
+			return len > 0 && buf[0] == LUA_SIGNATURE[0];
+		}
+
+		// dump function on top of L to file
+		bool saveBytecode(lua_State* L, const FString& path) {
+			TArray<uint8> bytecode;
+			if (lua_dump(L, writer, &bytecode, 0) != 0)
+				return false;
+			return FFileHelper::SaveArrayToFile(bytecode, *path);
+		}
+	}
+
+	FString LuaBytecodeCache::getShippedDir()
+	{
+		return FPaths::ProjectContentDir() / TEXT("LuaBytecode");
+	}
+
+	FString LuaBytecodeCache::getSavedDir()
+	{
+		return FPaths::ProjectSavedDir() / TEXT("LuaBytecode");
+	}
+
+	FString LuaBytecodeCache::getChunkName(const FString& filepath)
+	{
+		FString contentDir = FPaths::ConvertRelativePathToFull(FPaths::ProjectContentDir());
+		FString fullPath = FPaths::ConvertRelativePathToFull(filepath);
+		if (fullPath.StartsWith(contentDir))
+			return TEXT("@") + fullPath.RightChop(contentDir.Len());
+		return TEXT("@") + filepath;
+	}
+
+	FString LuaBytecodeCache::getKey(const uint8* buf, uint32 len, const char* chunk)
+	{
+		FMD5 md5;
+		md5.Update((const uint8*)vmBuildId(), strlen(vmBuildId()));
+		// chunk name is saved in bytecode, same source of different files can't share it
+		if (chunk) md5.Update((const uint8*)chunk, strlen(chunk) + 1);
+		md5.Update(buf, len);
+		uint8 digest[16];
+		md5.Final(digest);
+		return BytesToHex(digest, 16) + TEXT(".luac");
+	}
+
+	int LuaBytecodeCache::load(lua_State* L, const uint8* buf, uint32 len, const char* chunk, bool writeCache)
+	{
+		// file is bytecode already
+		if (isBytecode(buf, len))
+			return luaL_loadbuffer(L, (const char*)buf, len, chunk);
+
+		FString key = getKey(buf, len, chunk);
+		TArray<uint8> bytecode;
+		for (const FString& dir : { getShippedDir(), getSavedDir() }) {
+			if (!FFileHelper::LoadFileToArray(bytecode, *(dir / key), FILEREAD_Silent))
+				continue;
+			if (luaL_loadbuffer(L, (const char*)bytecode.GetData(), bytecode.Num(), chunk) == 0)
+				return 0;
+			// broken cache file, compile source instead
+			lua_pop(L, 1);
+		}
+
+		int ret = luaL_loadbuffer(L, (const char*)buf, len, chunk);
+		// saved dir may be readonly on some platforms, just compile source next time
+		if (ret == 0 && writeCache)
+			saveBytecode(L, getSavedDir() / key);
+		return ret;
+	}
+
+	int32 LuaBytecodeCache::precompile(const FString& srcDir, const FString& dstDir, int32& failed)
+	{
+		failed = 0;
+		TArray<FString> files;
+		IFileManager::Get().FindFilesRecursive(files, *srcDir, TEXT("*.lua"), true, false);
+
+		lua_State* L = luaL_newstate();
+		int32 count = 0;
+		for (const FString& file : files) {
+			TArray<uint8> source;
+			if (!FFileHelper::LoadFileToArray(source, *file)) {
+				Log::Error("Can't read %s", TCHAR_TO_UTF8(*file));
+				failed++;
+				continue;
+			}
+			// same chunk name as runtime loader, it's a part of cache key
+			FTCHARToUTF8 chunk(*getChunkName(file));
+			if (luaL_loadbuffer(L, (const char*)source.GetData(), source.Num(), chunk.Get())) {
+				Log::Error("%s", lua_tostring(L, -1));
+				lua_pop(L, 1);
+				failed++;
+				continue;
+			}
+			if (saveBytecode(L, dstDir / getKey(source.GetData(), source.Num(), chunk.Get())))
+				count++;
+			else {
+				Log::Error("Can't save bytecode of %s", TCHAR_TO_UTF8(*file));
+				failed++;
+			}
+			lua_pop(L, 1);
+		}
+		lua_close(L);
+		return count;
+	}
+}
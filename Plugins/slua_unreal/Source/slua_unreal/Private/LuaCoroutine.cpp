@@ -0,0 +1,249 @@
+// Tencent is pleased to support the open source community by making sluaunreal available.
+
+// Copyright (C) 2018 THL A29 Limited, a Tencent company. All rights reserved.
+// Licensed under the BSD 3-Clause License (the "License");
+// you may not use this file except in compliance with the License. You may obtain a copy of the License at
+
+// https://opensource.org/licenses/BSD-3-Clause
+
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and limitations under the License.
+
+#include "LuaCoroutine.h"
+#include "LuaState.h"
+#include "LuaObject.h"
+#include "SluaLib.h"
+#include "Log.h"
+#include "UObject/Package.h"
+#include "Engine/Engine.h"
+#include "Engine/World.h"
+#include "LatentActions.h"
+
+void ULuaLatentCallback::OnLatentComplete(int32 Linkage)
+{
+	if (scheduler) scheduler->onLatentComplete(Linkage);
+}
+
+namespace slua {
+
+	LuaCoroutineScheduler::LuaCoroutineScheduler(lua_State* l)
+		: L(l)
+		, time(0)
+		, frame(0)
+		, latentUUID(0)
+	{
+		latentCallback = NewObject<ULuaLatentCallback>((UObject*)GetTransientPackage(), ULuaLatentCallback::StaticClass());
+		latentCallback->scheduler = this;
+		latentCallback->AddToRoot();
+	}
+
+	LuaCoroutineScheduler::~LuaCoroutineScheduler()
+	{
+		// refs of waiting threads are freed with lua state
+		latentCallback->scheduler = nullptr;
+		latentCallback->RemoveFromRoot();
+	}
+
+	void LuaCoroutineScheduler::reg(lua_State* L)
+	{
+		SluaUtil::reg(L, "wait", wait);
+		SluaUtil::reg(L, "waitFrames", waitFrames);
+		SluaUtil::reg(L, "waitUntil", waitUntil);
+	}
+
+	LuaCoroutineScheduler* LuaCoroutineScheduler::get(lua_State* L)
+	{
+		auto ls = LuaState::get(L);
+		return ls ? ls->coroutineScheduler() : nullptr;
+	}
+
+	int LuaCoroutineScheduler::suspend(lua_State* l, const char* fn)
+	{
+		if (!lua_isyieldable(l))
+			luaL_error(l, "%s must be called in coroutine", fn);
+		lua_pushthread(l);
+		return luaL_ref(l, LUA_REGISTRYINDEX);
+	}
+
+	int LuaCoroutineScheduler::wait(lua_State* L)
+	{
+		lua_Number seconds = luaL_checknumber(L, 1);
+		auto sched = get(L);
+		TimeWaiter waiter = { sched->suspend(L, "wait"), sched->time + seconds };
+		sched->timeQueue.HeapPush(waiter);
+		return lua_yield(L, 0);
+	}
+
+	int LuaCoroutineScheduler::waitFrames(lua_State* L)
+	{
+		lua_Integer n = luaL_checkinteger(L, 1);
+		auto sched = get(L);
+		FrameWaiter waiter = { sched->suspend(L, "waitFrames"), sched->frame + FMath::Max<lua_Integer>(n, 1) };
+		sched->frameQueue.HeapPush(waiter);
+		return lua_yield(L, 0);
+	}
+
+	int LuaCoroutineScheduler::waitUntil(lua_State* L)
+	{
+		auto sched = get(L);
+		// predicate function is called each frame until it return true
+		if (lua_isfunction(L, 1)) {
+			lua_pushvalue(L, 1);
+			int funcRef = luaL_ref(L, LUA_REGISTRYINDEX);
+			PredicateWaiter waiter = { sched->suspend(L, "waitUntil"), funcRef };
+			sched->predicateWaiters.Add(waiter);
+			return lua_yield(L, 0);
+		}
+
+		// multicast delegate, resume when it broadcast
+		luaL_checktype(L, 1, LUA_TUSERDATA);
+		int threadRef = sched->suspend(L, "waitUntil");
+		lua_getfield(L, 1, "Add");
+		lua_pushvalue(L, 1);
+		lua_pushthread(L);
+		lua_pushcclosure(L, onDelegateFired, 1);
+		lua_call(L, 2, 1);
+		void* handle = lua_touserdata(L, -1);
+		lua_pop(L, 1);
+
+		lua_pushvalue(L, 1);
+		DelegateWaiter waiter = { threadRef, luaL_ref(L, LUA_REGISTRYINDEX), handle };
+		sched->delegateWaiters.Add(L, waiter);
+		return lua_yield(L, 0);
+	}
+
+	int LuaCoroutineScheduler::onDelegateFired(lua_State* L)
+	{
+		// resume in tick, listener can't be removed during broadcast
+		lua_State* thread = lua_tothread(L, lua_upvalueindex(1));
+		auto sched = get(L);
+		if (sched && sched->delegateWaiters.Contains(thread))
+			sched->firedDelegates.AddUnique(thread);
+		return 0;
+	}
+
+	void LuaCoroutineScheduler::awaitLatent(lua_State* l, FLatentActionInfo& info)
+	{
+		int threadRef = suspend(l, "latent function");
+		// uuid should be unique for each callback target
+		int32 uuid = ++latentUUID;
+		latentWaiters.Add(uuid, threadRef);
+		info = FLatentActionInfo(uuid, uuid, TEXT("OnLatentComplete"), latentCallback);
+	}
+
+	bool LuaCoroutineScheduler::checkLatentStarted(int32 uuid)
+	{
+		// action is added to latent action manager of world from world context
+		if (GEngine) {
+			for (const FWorldContext& context : GEngine->GetWorldContexts()) {
+				UWorld* world = context.World();
+				if (world && world->GetLatentActionManager().FindExistingAction<FPendingLatentAction>(latentCallback, uuid))
+					return true;
+			}
+		}
+		int threadRef;
+		if (latentWaiters.RemoveAndCopyValue(uuid, threadRef))
+			luaL_unref(L, LUA_REGISTRYINDEX, threadRef);
+		return false;
+	}
+
+	void LuaCoroutineScheduler::onLatentComplete(int32 linkage)
+	{
+		int threadRef;
+		if (latentWaiters.RemoveAndCopyValue(linkage, threadRef))
+			wake(threadRef);
+	}
+
+	void LuaCoroutineScheduler::wake(int threadRef)
+	{
+		readyThreads.Add(threadRef);
+	}
+
+	void LuaCoroutineScheduler::resume(int threadRef)
+	{
+		lua_rawgeti(L, LUA_REGISTRYINDEX, threadRef);
+		luaL_unref(L, LUA_REGISTRYINDEX, threadRef);
+		// thread stay on stack of L during resume, so it can't be collected
+		lua_State* co = lua_tothread(L, -1);
+		if (co) {
+			LuaScriptCallGuard g(L);
+			int status = lua_resume(co, L, 0);
+			if (status != LUA_OK && status != LUA_YIELD) {
+				luaL_traceback(L, co, lua_tostring(co, -1), 0);
+				Log::Error("%s", lua_tostring(L, -1));
+				lua_pop(L, 1);
+			}
+			// drop returned or yielded values
+			lua_settop(co, 0);
+		}
+		lua_pop(L, 1);
+	}
+
+	void LuaCoroutineScheduler::tick(float dtime)
+	{
+		time += dtime;
+		frame++;
+
+		// collect due waiters before resume,
+		// resumed coroutine may wait again and should be resumed next frame at least
+		TArray<int> due;
+		while (timeQueue.Num() > 0 && timeQueue.HeapTop().wakeTime <= time) {
+			TimeWaiter waiter;
+			timeQueue.HeapPop(waiter, false);
+			due.Add(waiter.threadRef);
+		}
+		while (frameQueue.Num() > 0 && frameQueue.HeapTop().wakeFrame <= frame) {
+			FrameWaiter waiter;
+			frameQueue.HeapPop(waiter, false);
+			due.Add(waiter.threadRef);
+		}
+		for (int threadRef : due)
+			resume(threadRef);
+
+		TArray<lua_State*> fired = MoveTemp(firedDelegates);
+		for (lua_State* thread : fired) {
+			DelegateWaiter waiter;
+			if (!delegateWaiters.RemoveAndCopyValue(thread, waiter))
+				continue;
+			// remove listener by delegate:Remove(handle)
+			lua_rawgeti(L, LUA_REGISTRYINDEX, waiter.delegateRef);
+			lua_getfield(L, -1, "Remove");
+			lua_pushvalue(L, -2);
+			lua_pushlightuserdata(L, waiter.handle);
+			if (lua_pcall(L, 2, 0, 0)) {
+				Log::Error("%s", lua_tostring(L, -1));
+				lua_pop(L, 1);
+			}
+			lua_pop(L, 1);
+			luaL_unref(L, LUA_REGISTRYINDEX, waiter.delegateRef);
+			resume(waiter.threadRef);
+		}
+
+		TArray<int> ready = MoveTemp(readyThreads);
+		for (int threadRef : ready)
+			resume(threadRef);
+
+		// resumed coroutine may add new predicate, check it next frame
+		TArray<PredicateWaiter> waiters = MoveTemp(predicateWaiters);
+		for (const PredicateWaiter& waiter : waiters) {
+			int errfunc = LuaState::pushErrorHandler(L);
+			lua_rawgeti(L, LUA_REGISTRYINDEX, waiter.funcRef);
+			bool ready = true;
+			{
+				LuaScriptCallGuard g(L);
+				// error in predicate resume coroutine, so it isn't leaked
+				if (!lua_pcall(L, 0, 1, errfunc))
+					ready = !!lua_toboolean(L, -1);
+			}
+			lua_settop(L, errfunc - 1);
+			if (!ready) {
+				predicateWaiters.Add(waiter);
+				continue;
+			}
+			luaL_unref(L, LUA_REGISTRYINDEX, waiter.funcRef);
+			resume(waiter.threadRef);
+		}
+	}
+}
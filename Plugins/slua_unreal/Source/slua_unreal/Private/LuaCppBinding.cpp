@@ -22,6 +22,10 @@ namespace slua {
         luaclasses->Add(setup);
     }
 
+    LuaClass::LuaClass(const char* name, lua_CFunction setup) {
+        LuaObject::addLazyType(name, setup);
+    }
+
     void LuaClass::reg(lua_State* L) {
         if(!luaclasses)
             return;
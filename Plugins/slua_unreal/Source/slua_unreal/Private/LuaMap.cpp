@@ -30,14 +30,13 @@
 
 namespace slua {
 
-	DefTypeName(LuaMap::Enumerator);
-
 	void LuaMap::reg(lua_State* L) {
 		SluaUtil::reg(L, "Map", __ctor);
+		SluaUtil::reg(L, "MapFromTable", FromTable);
 	}
 
-	int LuaMap::push(lua_State* L, UProperty* keyProp, UProperty* valueProp, const FScriptMap* buf, bool frombp) {
-		auto luaMap = new LuaMap(keyProp, valueProp, buf, frombp);
+	int LuaMap::push(lua_State* L, UProperty* keyProp, UProperty* valueProp, const FScriptMap* buf, bool frombp, bool byMove) {
+		auto luaMap = new LuaMap(keyProp, valueProp, buf, frombp, byMove);
 		return LuaObject::pushType(L, luaMap, "LuaMap", setupMT, gc);
 	}
 
@@ -64,16 +63,21 @@ namespace slua {
 	}
 
 
-	LuaMap::LuaMap(UProperty* kp, UProperty* vp, const FScriptMap* buf, bool frombp) : 
+	LuaMap::LuaMap(UProperty* kp, UProperty* vp, const FScriptMap* buf, bool frombp, bool byMove) : 
 		map( new FScriptMap ),
 		keyProp(kp), 
 		valueProp(vp) ,
 		prop(nullptr),
 		propObj(nullptr),
-		helper(FScriptMapHelper::CreateHelperFormInnerProperties(keyProp, valueProp, map)) 
+		helper(FScriptMapHelper::CreateHelperFormInnerProperties(keyProp, valueProp, map)) ,
+		movable(false)
 	{
 		if (buf) {
-			clone(map,kp,vp,buf);
+			// take storage of temporary map, no pair copied
+			if (byMove)
+				map->MoveAssign(*const_cast<FScriptMap*>(buf), helper.MapLayout);
+			else
+				clone(map,kp,vp,buf);
 			createdByBp = frombp;
 		} else {
 			createdByBp = false;
@@ -87,7 +91,8 @@ namespace slua {
 		prop(p),
 		propObj(obj),
 		helper(prop, map) ,
-		createdByBp(false)
+		createdByBp(false) ,
+		movable(false)
 	{
 	} 
 
@@ -213,21 +218,6 @@ namespace slua {
 		}
 	}
 
-	// modified FScriptMapHelper::RemovePair function to call LuaMap::RemoveAt
-	bool LuaMap::removePair(const void* KeyPtr) {
-		UProperty* LocalKeyPropForCapture = keyProp;
-		if (uint8* Entry = map->FindValue(KeyPtr, helper.MapLayout,
-			[LocalKeyPropForCapture](const void* ElementKey) { return LocalKeyPropForCapture->GetValueTypeHash(ElementKey); },
-			[LocalKeyPropForCapture](const void* A, const void* B) { return LocalKeyPropForCapture->Identical(A, B); }
-		)) {
-			int32 Idx = (Entry - (uint8*)map->GetData(0, helper.MapLayout)) / helper.MapLayout.SetLayout.Size;
-			removeAt(Idx);
-			return true;
-		} else {
-			return false;
-		}
-	}
-
 	// modified FScriptMapHelper::RemoveAt function to call LuaMap::DestructItems
 	void LuaMap::removeAt(int32 Index, int32 Count) {
 		check(helper.IsValidIndex(Index));
@@ -247,24 +237,124 @@ namespace slua {
 	int LuaMap::__ctor(lua_State* L) {
 		auto keyType = (EPropertyClass)LuaObject::checkValue<int>(L, 1);
 		auto valueType = (EPropertyClass)LuaObject::checkValue<int>(L, 2);
-		auto keyProp = PropertyProto::createProperty(keyType);
-		auto valueProp = PropertyProto::createProperty(valueType);
+		auto keyProp = PropertyProto::getProperty(keyType);
+		auto valueProp = PropertyProto::getProperty(valueType);
 		return push(L, keyProp, valueProp, nullptr);
 	}
 
+	void LuaMap::moveOrClone(UProperty* destKeyProp, UProperty* destValueProp, FScriptMap* dest) {
+		bool move = movable;
+		movable = false;
+		// only map owned by lua can be moved, to an empty dest with same key and value type
+		if (move && !prop && dest->Num() == 0
+			&& destKeyProp->GetClass() == keyProp->GetClass() && destKeyProp->ElementSize == keyProp->ElementSize
+			&& destValueProp->GetClass() == valueProp->GetClass() && destValueProp->ElementSize == valueProp->ElementSize) {
+			dest->MoveAssign(*map, helper.MapLayout);
+			return;
+		}
+		clone(dest, destKeyProp, destValueProp, map);
+	}
+
+	void LuaMap::fillFromTable(lua_State* L, int p, UProperty* keyProp, UProperty* valueProp, FScriptMapHelper& helper) {
+		p = lua_absindex(L, p);
+		auto keyChecker = LuaObject::getChecker(keyProp);
+		auto valueChecker = LuaObject::getChecker(valueProp);
+		if (!keyChecker || !valueChecker) {
+			luaL_error(L, "unsupport map key or value type");
+		}
+		FDefaultConstructedPropertyElement tempKey(keyProp);
+		FDefaultConstructedPropertyElement tempValue(valueProp);
+		auto keyPtr = tempKey.GetObjAddress();
+		auto valuePtr = tempValue.GetObjAddress();
+		lua_pushnil(L);
+		while (lua_next(L, p)) {
+			// check copy of key, checker may convert key in place and break lua_next
+			lua_pushvalue(L, -2);
+			keyChecker(L, keyProp, (uint8*)keyPtr, lua_gettop(L));
+			valueChecker(L, valueProp, (uint8*)valuePtr, lua_gettop(L) - 1);
+			helper.AddPair(keyPtr, valuePtr);
+			lua_pop(L, 2);
+		}
+	}
+
+	// slua.MapFromTable(t,keyType,valueType), create map from lua table in one call
+	int LuaMap::FromTable(lua_State* L) {
+		luaL_checktype(L, 1, LUA_TTABLE);
+		auto keyType = (EPropertyClass)LuaObject::checkValue<int>(L, 2);
+		auto valueType = (EPropertyClass)LuaObject::checkValue<int>(L, 3);
+		auto keyProp = PropertyProto::getProperty(keyType);
+		auto valueProp = PropertyProto::getProperty(valueType);
+		if (!keyProp || !valueProp)
+			luaL_error(L, "unsupport map key or value type");
+		auto luaMap = new LuaMap(keyProp, valueProp, nullptr, false);
+		LuaObject::pushType(L, luaMap, "LuaMap", setupMT, gc);
+		fillFromTable(L, 1, keyProp, valueProp, luaMap->helper);
+		return 1;
+	}
+
+	int LuaMap::ToTable(lua_State* L) {
+		CheckUD(LuaMap, L, 1);
+		auto& helper = UD->helper;
+		lua_createtable(L, 0, helper.Num());
+		for (int32 index = 0; index < helper.GetMaxIndex(); index++) {
+			if (!helper.IsValidIndex(index)) continue;
+			auto pairPtr = helper.GetPairPtr(index);
+			LuaObject::push(L, UD->keyProp, UD->getKeyPtr(pairPtr));
+			LuaObject::push(L, UD->valueProp, UD->getValuePtr(pairPtr));
+			lua_rawset(L, -3);
+		}
+		return 1;
+	}
+
 	int LuaMap::Num(lua_State* L) {
 		CheckUD(LuaMap, L, 1);
 		return LuaObject::push(L, UD->num());
 	}
 
-	int LuaMap::Get(lua_State* L) {
-		CheckUD(LuaMap, L, 1);
-		GET_CHECKER(key);
-		FDefaultConstructedPropertyElement tempKey(UD->keyProp);
+	// find value by lua key at p, numeric, FName and FString key are hashed and compared
+	// without constructing a temporary key element
+	uint8* LuaMap::findValue(lua_State* L, int p) {
+		if (keyProp->IsA<UNumericProperty>()) {
+			// numeric key is 8 bytes at most, check it into stack buffer
+			uint64 keyBuf = 0;
+			LuaObject::getChecker(keyProp)(L, keyProp, (uint8*)&keyBuf, p);
+			return helper.FindValueFromHash(&keyBuf);
+		}
+		else if (keyProp->IsA<UNameProperty>()) {
+			const char* s = LuaObject::checkValue<const char*>(L, p);
+			// don't add name to name table, a name not exists can't be in map
+			FName name(UTF8_TO_TCHAR(s), FNAME_Find);
+			if (name.IsNone() && *s && FCStringAnsi::Stricmp(s, "None") != 0)
+				return nullptr;
+			return helper.FindValueFromHash(&name);
+		}
+		else if (keyProp->IsA<UStrProperty>()) {
+			// hash and compare TCHAR string same as GetTypeHash and operator== of FString,
+			// key is at head of pair
+			FUTF8ToTCHAR str(LuaObject::checkValue<const char*>(L, p));
+			return map->FindValue(str.Get(), helper.MapLayout,
+				[](const void* key) { return FCrc::Strihash_DEPRECATED((const TCHAR*)key); },
+				[](const void* a, const void* b) { return FCString::Stricmp((const TCHAR*)a, **(const FString*)b) == 0; });
+		}
+
+		auto keyChecker = LuaObject::getChecker(keyProp);
+		if (!keyChecker) {
+			auto tn = keyProp->GetClass()->GetName();
+			luaL_error(L, "unsupport key type %s to get", TCHAR_TO_UTF8(*tn));
+		}
+		FDefaultConstructedPropertyElement tempKey(keyProp);
 		auto keyPtr = tempKey.GetObjAddress();
-		keyChecker(L, UD->keyProp, (uint8*)keyPtr, 2);
+		keyChecker(L, keyProp, (uint8*)keyPtr, p);
+		return helper.FindValueFromHash(keyPtr);
+	}
+
+	int32 LuaMap::indexOfValue(uint8* valuePtr) {
+		return (valuePtr - (uint8*)map->GetData(0, helper.MapLayout)) / helper.MapLayout.SetLayout.Size;
+	}
 
-		auto valuePtr = UD->helper.FindValueFromHash(keyPtr);
+	int LuaMap::Get(lua_State* L) {
+		CheckUD(LuaMap, L, 1);
+		auto valuePtr = UD->findValue(L, 2);
 		if (valuePtr) {
 			LuaObject::push(L, UD->valueProp, valuePtr);
 			LuaObject::push(L, true);
@@ -277,8 +367,13 @@ namespace slua {
 
 	int LuaMap::Add(lua_State* L) {
 		CheckUD(LuaMap, L, 1);
-		GET_CHECKER(key);
 		GET_CHECKER(value);
+		// key exists, set value in place
+		if (auto valuePtr = UD->findValue(L, 2)) {
+			valueChecker(L, UD->valueProp, valuePtr, 3);
+			return 0;
+		}
+		GET_CHECKER(key);
 		FDefaultConstructedPropertyElement tempKey(UD->keyProp);
 		FDefaultConstructedPropertyElement tempValue(UD->valueProp);
 		auto keyPtr = tempKey.GetObjAddress();
@@ -291,11 +386,51 @@ namespace slua {
 
 	int LuaMap::Remove(lua_State* L) {
 		CheckUD(LuaMap, L, 1);
-		GET_CHECKER(key);
-		FDefaultConstructedPropertyElement tempKey(UD->keyProp);
-		auto keyPtr = tempKey.GetObjAddress();
-		keyChecker(L, UD->keyProp, (uint8*)keyPtr, 2);
-		return LuaObject::push(L, UD->removePair(keyPtr));
+		auto valuePtr = UD->findValue(L, 2);
+		if (!valuePtr)
+			return LuaObject::push(L, false);
+		UD->removeAt(UD->indexOfValue(valuePtr));
+		return LuaObject::push(L, true);
+	}
+
+	int LuaMap::Contains(lua_State* L) {
+		CheckUD(LuaMap, L, 1);
+		return LuaObject::push(L, UD->findValue(L, 2) != nullptr);
+	}
+
+	int LuaMap::Keys(lua_State* L) {
+		CheckUD(LuaMap, L, 1);
+		auto& helper = UD->helper;
+		lua_createtable(L, helper.Num(), 0);
+		int n = 1;
+		for (int32 index = 0; index < helper.GetMaxIndex(); index++) {
+			if (!helper.IsValidIndex(index)) continue;
+			LuaObject::push(L, UD->keyProp, UD->getKeyPtr(helper.GetPairPtr(index)));
+			lua_rawseti(L, -2, n++);
+		}
+		return 1;
+	}
+
+	int LuaMap::Values(lua_State* L) {
+		CheckUD(LuaMap, L, 1);
+		auto& helper = UD->helper;
+		lua_createtable(L, helper.Num(), 0);
+		int n = 1;
+		for (int32 index = 0; index < helper.GetMaxIndex(); index++) {
+			if (!helper.IsValidIndex(index)) continue;
+			LuaObject::push(L, UD->valueProp, UD->getValuePtr(helper.GetPairPtr(index)));
+			lua_rawseti(L, -2, n++);
+		}
+		return 1;
+	}
+
+	// map:Move(), mark map to be moved to next ufunction param instead of copied,
+	// map will be empty after that call, return self
+	int LuaMap::Move(lua_State* L) {
+		CheckUD(LuaMap, L, 1);
+		UD->movable = true;
+		lua_pushvalue(L, 1);
+		return 1;
 	}
 
 	int LuaMap::Clear(lua_State* L) {
@@ -304,44 +439,41 @@ namespace slua {
 		return 0;
 	}
 
+	// push first valid pair from index, return next index to iterate or INDEX_NONE if end
+	int LuaMap::pushPairFrom(lua_State* L, int32 index) {
+		for (; index < helper.GetMaxIndex(); index++) {
+			if (helper.IsValidIndex(index)) {
+				auto pairPtr = helper.GetPairPtr(index);
+				LuaObject::push(L, keyProp, getKeyPtr(pairPtr));
+				LuaObject::push(L, valueProp, getValuePtr(pairPtr));
+				return index;
+			}
+		}
+		return INDEX_NONE;
+	}
+
+	// iterate by a closure with sparse index as upvalue, one closure for each loop and no __gc,
+	// key isn't used to find next pair, so removing current pair or nil key don't end the loop
 	int LuaMap::Pairs(lua_State* L) {
 		CheckUD(LuaMap, L, 1);
-		auto iter = new LuaMap::Enumerator();
-		iter->map = UD;
-		iter->index = 0;
-		iter->num = UD->helper.Num();
-		lua_pushcfunction(L, LuaMap::Enumerable);
-		LuaObject::pushType(L, iter, "LuaMap::Enumerator", nullptr, LuaMap::Enumerator::gc);
+		LuaObject::push(L, 0);
+		lua_pushcclosure(L, LuaMap::EnumerableByIndex, 1);
+		lua_pushvalue(L, 1);
 		LuaObject::pushNil(L);
 		return 3;
 	}
 
-	int LuaMap::Enumerable(lua_State* L) {
-		CheckUD(LuaMap::Enumerator, L, 1);
-		auto map = UD->map;
-		auto& helper = map->helper;
-		do {
-			if (UD->num <= 0) {
-				return 0;
-			} else if (helper.IsValidIndex(UD->index)) {
-				auto pairPtr = helper.GetPairPtr(UD->index);
-				auto keyPtr = map->getKeyPtr(pairPtr);
-				auto valuePtr = map->getValuePtr(pairPtr);
-				LuaObject::push(L, map->keyProp, keyPtr);
-				LuaObject::push(L, map->valueProp, valuePtr);
-				UD->index += 1;
-				UD->num -= 1;
-				return 2;
-			} else {
-				UD->index += 1;
-			}
-		} while (true);
+	int LuaMap::EnumerableByIndex(lua_State* L) {
+		CheckUD(LuaMap, L, 1);
+		int32 index = UD->pushPairFrom(L, (int32)lua_tointeger(L, lua_upvalueindex(1)));
+		if (index == INDEX_NONE) return 0;
+		LuaObject::push(L, index + 1);
+		lua_replace(L, lua_upvalueindex(1));
+		return 2;
 	}
 
-	int LuaMap::Enumerator::gc(lua_State* L) {
-		CheckUD(LuaMap::Enumerator, L, 1);
-		delete UD;
-		return 0;
+	int LuaMap::__len(lua_State* L) {
+		return Num(L);
 	}
 
 	int LuaMap::gc(lua_State* L) {
@@ -359,8 +491,14 @@ namespace slua {
 		RegMetaMethod(L, Add);
 		RegMetaMethod(L, Remove);
 		RegMetaMethod(L, Clear);
+		RegMetaMethod(L, Move);
+		RegMetaMethod(L, ToTable);
+		RegMetaMethod(L, Contains);
+		RegMetaMethod(L, Keys);
+		RegMetaMethod(L, Values);
 
 		RegMetaMethodByName(L, "__pairs", Pairs);
+		RegMetaMethodByName(L, "__len", __len);
 
 		return 0;
 	}
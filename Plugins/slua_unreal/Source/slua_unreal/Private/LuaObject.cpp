@@ -27,11 +27,13 @@
 #include "LuaWidgetTree.h"
 #include "LuaArray.h"
 #include "LuaMap.h"
+#include "LuaSet.h"
 #include "Log.h"
 #include "LuaState.h"
 #include "LuaWrapper.h"
 #include "SluaUtil.h"
 #include "LuaReference.h"
+#include "LuaCoroutine.h"
 
 namespace slua { 
 
@@ -111,7 +113,7 @@ namespace slua {
                     lua_geti(L,-1,n+1);
                     const char* tn = lua_tostring(L,-1);
                     lua_pop(L,1); // pop tn
-                    luaL_getmetatable(L,tn);
+                    LuaObject::pushMetatable(L,tn);
 					luaL_checktype(L, -1, LUA_TTABLE);
 					if (findMember(L, name)) return 1;
                 }
@@ -145,7 +147,7 @@ namespace slua {
 					lua_geti(L, -1, n + 1);
 					const char* tn = lua_tostring(L, -1);
 					lua_pop(L, 1); // pop tn
-					luaL_getmetatable(L, tn);
+					LuaObject::pushMetatable(L, tn);
 					luaL_checktype(L, -1, LUA_TTABLE);
 					if (setMember(L, name)) return true;
 				}
@@ -187,7 +189,36 @@ namespace slua {
 		lua_setfield(L, -2, "__newindex");
 	}
 
+	namespace {
+		// type registered by newType, addMethod, addField, addOperator and finishType
+		struct TypeRecord {
+			enum Kind { Method, Field, Operator };
+			struct Entry {
+				Kind kind;
+				const char* name;
+				lua_CFunction func;
+				// setter of field
+				lua_CFunction setter;
+				bool isInstance;
+			};
+			TArray<Entry> entries;
+			lua_CFunction ctor = nullptr;
+			lua_CFunction gc = nullptr;
+			lua_CFunction strHint = nullptr;
+		};
+		typedef TMap<FString, TypeRecord> TypeRecords;
+
+		// not null while recording, types are added to it instead of lua state
+		TypeRecords* recordingTypes = nullptr;
+		// type between newType and finishType while recording
+		TypeRecord* recordingType = nullptr;
+	}
+
 	void LuaObject::newType(lua_State* L, const char* tn) {
+		if (recordingTypes) {
+			recordingType = &recordingTypes->Add(UTF8_TO_TCHAR(tn));
+			return;
+		}
 		lua_pushglobaltable(L);				    // _G
 		lua_newtable(L);							// local t = {}
 		lua_pushvalue(L, -1);
@@ -230,7 +261,7 @@ namespace slua {
 
 	bool LuaObject::isBaseTypeOf(lua_State* L,const char* tn,const char* base) {
         AutoStack as(L);
-        int t = luaL_getmetatable(L,tn);
+        int t = pushMetatable(L,tn);
         if(t!=LUA_TTABLE)
             return false;
 
@@ -249,6 +280,10 @@ namespace slua {
     }
 
 	void LuaObject::addMethod(lua_State* L, const char* name, lua_CFunction func, bool isInstance) {
+		if (recordingType) {
+			recordingType->entries.Add({ TypeRecord::Method, name, func, nullptr, isInstance });
+			return;
+		}
 		lua_pushcfunction(L, func);
 		lua_setfield(L, isInstance ? -2 : -3, name);
 	}
@@ -259,6 +294,10 @@ namespace slua {
 	}
 
 	void LuaObject::addField(lua_State* L, const char* name, lua_CFunction getter, lua_CFunction setter, bool isInstance) {
+		if (recordingType) {
+			recordingType->entries.Add({ TypeRecord::Field, name, getter, setter, isInstance });
+			return;
+		}
 		lua_getfield(L, isInstance ? -1 : -2, ".get");
 		lua_pushcfunction(L, getter);
 		lua_setfield(L, -2, name);
@@ -270,11 +309,22 @@ namespace slua {
 	}
 
 	void LuaObject::addOperator(lua_State* L, const char* name, lua_CFunction func) {
+		if (recordingType) {
+			recordingType->entries.Add({ TypeRecord::Operator, name, func, nullptr, false });
+			return;
+		}
 		lua_pushcfunction(L, func);
 		lua_setfield(L, -2, name);
 	}
 
 	void LuaObject::finishType(lua_State* L, const char* tn, lua_CFunction ctor, lua_CFunction gc, lua_CFunction strHint) {
+		if (recordingType) {
+			recordingType->ctor = ctor;
+			recordingType->gc = gc;
+			recordingType->strHint = strHint;
+			recordingType = nullptr;
+			return;
+		}
         if(ctor) {
 		    lua_pushcclosure(L, ctor, 0);
 		    lua_setfield(L, -3, "__call");
@@ -423,8 +473,17 @@ namespace slua {
         
     }
 
-    void fillParam(lua_State* L,int i,UFunction* func,uint8* params) {
+    bool isLatentActionInfo(UProperty* prop) {
+        auto sp = Cast<UStructProperty>(prop);
+        return sp && sp->Struct==FLatentActionInfo::StaticStruct();
+    }
+
+    // if called in coroutine and lua passed none or nil to FLatentActionInfo param,
+    // it's filled to resume coroutine when latent action completed,
+    // return the filled param if coroutine should yield after call
+    FLatentActionInfo* fillParam(lua_State* L,int i,UFunction* func,uint8* params) {
 		auto funcFlag = func->FunctionFlags;
+        FLatentActionInfo* awaitLatent = nullptr;
         for(TFieldIterator<UProperty> it(func);it && (it->PropertyFlags&CPF_Parm);++it) {
             UProperty* prop = *it;
             uint64 propflag = prop->GetPropertyFlags();
@@ -435,9 +494,28 @@ namespace slua {
 			else if (IsRealOutParam(propflag))
 				continue;
 
+            if(!awaitLatent && lua_isnoneornil(L,i) && lua_isyieldable(L) && isLatentActionInfo(prop)) {
+                awaitLatent = reinterpret_cast<FLatentActionInfo*>(params+prop->GetOffset_ForInternal());
+                LuaState::get(L)->coroutineScheduler()->awaitLatent(L,*awaitLatent);
+                i++;
+                continue;
+            }
+
             fillParamFromState(L,prop,params+prop->GetOffset_ForInternal(),i);
             i++;
         }
+        return awaitLatent;
+    }
+
+    // params is a temporary frame, move container out of it instead of deep copy
+    int pushParam(lua_State* L,UProperty* p,uint8* parms) {
+        if(auto ap = Cast<UArrayProperty>(p))
+            return LuaArray::push(L, ap->Inner, ap->GetPropertyValuePtr(parms), true);
+        if(auto mp = Cast<UMapProperty>(p))
+            return LuaMap::push(L, mp->KeyProp, mp->ValueProp, mp->GetPropertyValuePtr(parms), true, true);
+        if(auto sp = Cast<USetProperty>(p))
+            return LuaSet::push(L, sp->ElementProp, sp->GetPropertyValuePtr(parms), true);
+        return LuaObject::push(L,p,parms);
     }
 
     // handle return value and out params
@@ -450,7 +528,7 @@ namespace slua {
         int ret = 0;
         if(bHasReturnParam) {
             UProperty* p = func->GetReturnProperty();
-            ret += LuaObject::push(L,p,params+p->GetOffset_ForInternal());
+            ret += pushParam(L,p,params+p->GetOffset_ForInternal());
         }
 
         // push out parms
@@ -463,7 +541,7 @@ namespace slua {
 
 			// out params should be not const and not readonly
             if(IsRealOutParam(propflag))
-                ret += LuaObject::push(L,p,params+p->GetOffset_ForInternal());
+                ret += pushParam(L,p,params+p->GetOffset_ForInternal());
         }
         
         return ret;
@@ -493,15 +571,23 @@ namespace slua {
         
         UFunction* func = reinterpret_cast<UFunction*>(ud);
         
-		FStructOnScope params(func);
-		fillParam(L, offset, func, params.GetStructMemory());
 		{
-			FEditorScriptExecutionGuard scriptGuard;
-			// call function with params
-			obj->ProcessEvent(func, params.GetStructMemory());
+			FStructOnScope params(func);
+			FLatentActionInfo* awaitLatent = fillParam(L, offset, func, params.GetStructMemory());
+			{
+				FEditorScriptExecutionGuard scriptGuard;
+				// call function with params
+				obj->ProcessEvent(func, params.GetStructMemory());
+			}
+			// function may not register latent action, e.g. world context without world
+			if (awaitLatent && !LuaState::get(L)->coroutineScheduler()->checkLatentStarted(awaitLatent->UUID))
+				awaitLatent = nullptr;
+			// return value to push lua stack
+			if (!awaitLatent)
+				return returnValue(L, func, params.GetStructMemory());
 		}
-		// return value to push lua stack
-		return returnValue(L, func, params.GetStructMemory());
+		// params should be destroyed before yield
+		return lua_yield(L, 0);
     }
 
     // find ufunction from cache
@@ -680,7 +766,7 @@ namespace slua {
 
 	void LuaObject::setupMetaTable(lua_State* L, const char* tn, lua_CFunction gc)
 	{
-		luaL_getmetatable(L, tn);
+		pushMetatable(L, tn);
 		if (lua_isnil(L, -1))
 			luaL_error(L, "Can't find type %s exported", tn);
 
@@ -722,16 +808,46 @@ namespace slua {
     int checkUArrayProperty(lua_State* L,UProperty* prop,uint8* parms,int i) {
         auto p = Cast<UArrayProperty>(prop);
         ensure(p);
+        // accept plain lua table, convert it directly into parms
+        if(lua_istable(L,i)) {
+            LuaArray::fillFromTable(L,i,p->Inner,(FScriptArray*)parms);
+            return 0;
+        }
         CheckUD(LuaArray,L,i);
-        LuaArray::clone((FScriptArray*)parms,p->Inner,UD->get());
+        UD->moveOrClone(p->Inner,(FScriptArray*)parms);
         return 0;
     }
 
 	int checkUMapProperty(lua_State* L, UProperty* prop, uint8* parms, int i) {
 		auto p = Cast<UMapProperty>(prop);
 		ensure(p);
+		if (lua_istable(L, i)) {
+			FScriptMapHelper helper(p, parms);
+			LuaMap::fillFromTable(L, i, p->KeyProp, p->ValueProp, helper);
+			return 0;
+		}
 		CheckUD(LuaMap, L, i);
-        LuaMap::clone((FScriptMap*)parms,p->KeyProp,p->ValueProp,UD->get());
+		UD->moveOrClone(p->KeyProp, p->ValueProp, (FScriptMap*)parms);
+		return 0;
+	}
+
+    int pushUSetProperty(lua_State* L,UProperty* prop,uint8* parms) {
+        auto p = Cast<USetProperty>(prop);
+        ensure(p);
+		FScriptSet* v = p->GetPropertyValuePtr(parms);
+		return LuaSet::push(L, p->ElementProp, v);
+    }
+
+	int checkUSetProperty(lua_State* L, UProperty* prop, uint8* parms, int i) {
+		auto p = Cast<USetProperty>(prop);
+		ensure(p);
+		if (lua_istable(L, i)) {
+			FScriptSetHelper helper(p, parms);
+			LuaSet::fillFromTable(L, i, helper);
+			return 0;
+		}
+		CheckUD(LuaSet, L, i);
+		UD->moveOrClone(p->ElementProp, (FScriptSet*)parms);
 		return 0;
 	}
 
@@ -899,13 +1015,44 @@ namespace slua {
     }
 
 	void LuaObject::releaseLink(lua_State* L, void* prop) {
-		LuaState* ls = LuaState::get(L);
-		ls->releaseLink(prop);
+		auto propud = reinterpret_cast<GenericUserData*>(prop);
+		// if prop owned memory, all children point to freed memory
+		bool owned = !!(propud->flag & UD_AUTOGC);
+		if (!owned) propud->flag |= UD_HADFREE;
+
+		// unlink prop from its parent
+		if (auto parentud = reinterpret_cast<GenericUserData*>(propud->parent)) {
+			auto prev = reinterpret_cast<GenericUserData*>(propud->prev);
+			auto next = reinterpret_cast<GenericUserData*>(propud->next);
+			if (prev) prev->next = next;
+			else parentud->children = next;
+			if (next) next->prev = prev;
+		}
+
+		// detach all children
+		auto child = reinterpret_cast<GenericUserData*>(propud->children);
+		while (child) {
+			auto next = reinterpret_cast<GenericUserData*>(child->next);
+			if (owned) child->flag |= UD_HADFREE;
+			InitUDLink(child);
+			child = next;
+		}
+		InitUDLink(propud);
 	}
 
 	void LuaObject::linkProp(lua_State* L, void* parent, void* prop) {
-		LuaState* ls = LuaState::get(L);
-		ls->linkProp(parent,prop);
+		auto parentud = reinterpret_cast<GenericUserData*>(parent);
+		auto propud = reinterpret_cast<GenericUserData*>(prop);
+		// linked prop always point to root directly, 
+		// so root of parent is parent itself or its parent
+		if (parentud->parent)
+			parentud = reinterpret_cast<GenericUserData*>(parentud->parent);
+		propud->parent = parentud;
+		propud->prev = nullptr;
+		propud->next = parentud->children;
+		if (parentud->children)
+			reinterpret_cast<GenericUserData*>(parentud->children)->prev = propud;
+		parentud->children = propud;
 	}
 
     void LuaObject::cacheObj(lua_State* L,void* obj) {
@@ -1022,6 +1169,43 @@ namespace slua {
 		checkerMap.Add(T::StaticClass(), checkUProperty<T>);
     }
 
+	namespace {
+		TMap<FString, TFunction<void(lua_State*)>>& lazyTypes() {
+			// may be added by static LuaClass before module loaded
+			static TMap<FString, TFunction<void(lua_State*)>> types;
+			return types;
+		}
+
+		// registry field of pending lazy types table
+		const char* PendingLazyTypes = "__slua_lazytypes";
+
+		// types bound by generated LuaWrapper::init, recorded once by struct name
+		TypeRecords& wrapperRecords() {
+			static TypeRecords types;
+			return types;
+		}
+
+		// same as bind function of recorded type
+		void bindRecordedType(lua_State* L, const char* tn, const TypeRecord& record) {
+			AutoStack autoStack(L);
+			LuaObject::newType(L, tn);
+			for (const auto& e : record.entries) {
+				switch (e.kind) {
+				case TypeRecord::Method:
+					LuaObject::addMethod(L, e.name, e.func, e.isInstance);
+					break;
+				case TypeRecord::Field:
+					LuaObject::addField(L, e.name, e.func, e.setter, e.isInstance);
+					break;
+				case TypeRecord::Operator:
+					LuaObject::addOperator(L, e.name, e.func);
+					break;
+				}
+			}
+			LuaObject::finishType(L, tn, record.ctor, record.gc, record.strHint);
+		}
+	}
+
     void LuaObject::init(lua_State* L) {
 		regPusher<UIntProperty>();
 		regPusher<UUInt32Property>();
@@ -1043,6 +1227,7 @@ namespace slua {
         regPusher(UObjectProperty::StaticClass(),pushUObjectProperty);
         regPusher(UArrayProperty::StaticClass(),pushUArrayProperty);
         regPusher(UMapProperty::StaticClass(),pushUMapProperty);
+        regPusher(USetProperty::StaticClass(),pushUSetProperty);
         regPusher(UStructProperty::StaticClass(),pushUStructProperty);
 		regPusher(UEnumProperty::StaticClass(), pushEnumProperty);
 		regPusher(UClassProperty::StaticClass(), pushUClassProperty);
@@ -1066,14 +1251,92 @@ namespace slua {
 
         regChecker(UArrayProperty::StaticClass(),checkUArrayProperty);
         regChecker(UMapProperty::StaticClass(),checkUMapProperty);
+        regChecker(USetProperty::StaticClass(),checkUSetProperty);
         regChecker(UDelegateProperty::StaticClass(),checkUDelegateProperty);
         regChecker(UStructProperty::StaticClass(),checkUStructProperty);
 		regChecker(UClassProperty::StaticClass(), checkUClassProperty);
 		
-		LuaWrapper::init(L);
         ExtensionMethod::init();
+
+		// generated LuaWrapper::init bind all wrapped structs, record bind of each struct once,
+		// and bind a struct in each state when it's first used.
+		// push and check functions of wrapped structs are filled by recording, they're shared by all states
+		TypeRecords& wrappers = wrapperRecords();
+		if (wrappers.Num() == 0) {
+			recordingTypes = &wrappers;
+			LuaWrapper::init(L);
+			recordingTypes = nullptr;
+			for (auto& it : wrappers) {
+				const TypeRecord* record = &it.Value();
+				FString tn = it.Key;
+				addLazyType(TCHAR_TO_UTF8(*tn), [record, tn](lua_State* L) {
+					bindRecordedType(L, TCHAR_TO_UTF8(*tn), *record);
+				});
+			}
+		}
+
+		// lazy types not setup in this state yet, name to true
+		lua_newtable(L);
+		for (auto& it : lazyTypes()) {
+			lua_pushboolean(L, true);
+			lua_setfield(L, -2, TCHAR_TO_UTF8(*it.Key));
+		}
+		lua_pushvalue(L, -1);
+		lua_setfield(L, LUA_REGISTRYINDEX, PendingLazyTypes);
+
+		// setup lazy type when its global table first accessed
+		lua_pushglobaltable(L);
+		lua_newtable(L);
+		lua_pushvalue(L, -3);
+		lua_pushcclosure(L, lazyGlobalIndex, 1);
+		lua_setfield(L, -2, "__index");
+		lua_setmetatable(L, -2);
+		lua_pop(L, 2);
     }
 
+	void LuaObject::addLazyType(const char* tn, TFunction<void(lua_State*)> setup) {
+		lazyTypes().Add(UTF8_TO_TCHAR(tn), MoveTemp(setup));
+	}
+
+	bool LuaObject::setupLazyType(lua_State* L, const char* tn) {
+		lua_getfield(L, LUA_REGISTRYINDEX, PendingLazyTypes);
+		if (lua_getfield(L, -1, tn) == LUA_TNIL) {
+			lua_pop(L, 2);
+			return false;
+		}
+		lua_pop(L, 1);
+		lua_pushnil(L);
+		lua_setfield(L, -2, tn);
+		lua_pop(L, 1);
+
+		auto setup = lazyTypes().Find(UTF8_TO_TCHAR(tn));
+		if (!setup) return false;
+		(*setup)(L);
+		return true;
+	}
+
+	int LuaObject::pushMetatable(lua_State* L, const char* tn) {
+		int t = luaL_getmetatable(L, tn);
+		if (t != LUA_TNIL || !setupLazyType(L, tn))
+			return t;
+		lua_pop(L, 1);
+		return luaL_getmetatable(L, tn);
+	}
+
+	// __index of _G, (_G, key), upvalue is table of pending lazy types
+	int LuaObject::lazyGlobalIndex(lua_State* L) {
+		// most missing globals aren't lazy type, return nil by one rawget
+		lua_pushvalue(L, 2);
+		if (lua_rawget(L, lua_upvalueindex(1)) == LUA_TNIL)
+			return 1;
+		lua_pop(L, 1);
+		if (!setupLazyType(L, lua_tostring(L, 2)))
+			return 0;
+		lua_pushvalue(L, 2);
+		lua_rawget(L, 1);
+		return 1;
+	}
+
     int LuaObject::push(lua_State* L,UFunction* func,UClass* cls)  {
         lua_pushlightuserdata(L, func);
         if(cls) {
@@ -1104,6 +1367,9 @@ namespace slua {
         // if it's an UMapProperty
         else if(cls==UMapProperty::StaticClass())
             return LuaMap::push(L,Cast<UMapProperty>(up),obj);
+        // if it's an USetProperty
+        else if(cls==USetProperty::StaticClass())
+            return LuaSet::push(L,Cast<USetProperty>(up),obj);
 		else
 			return push(L, up, up->ContainerPtrToValuePtr<uint8>(obj));
 	}
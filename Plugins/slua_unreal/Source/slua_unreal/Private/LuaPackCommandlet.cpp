@@ -0,0 +1,34 @@
+// Tencent is pleased to support the open source community by making sluaunreal available.
+
+// Copyright (C) 2018 THL A29 Limited, a Tencent company. All rights reserved.
+// Licensed under the BSD 3-Clause License (the "License");
+// you may not use this file except in compliance with the License. You may obtain a copy of the License at
+
+// https://opensource.org/licenses/BSD-3-Clause
+
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and limitations under the License.
+
+#include "LuaPackCommandlet.h"
+#include "LuaScriptArchive.h"
+#include "Log.h"
+#include "Misc/Paths.h"
+#include "Misc/Parse.h"
+
+int32 ULuaPackCommandlet::Main(const FString& Params)
+{
+	FString srcDir = FPaths::ProjectContentDir() / TEXT("Lua");
+	FString dstPath = FPaths::ProjectContentDir() / TEXT("Lua.slpk");
+	FParse::Value(*Params, TEXT("Source="), srcDir);
+	FParse::Value(*Params, TEXT("Output="), dstPath);
+	bool compress = FParse::Param(*Params, TEXT("Compress"));
+
+	if (!slua::LuaScriptArchive::pack(srcDir, dstPath, compress)) {
+		slua::Log::Error("Pack lua files to %s failed", TCHAR_TO_UTF8(*dstPath));
+		return 1;
+	}
+	slua::Log::Log("Packed lua files to %s", TCHAR_TO_UTF8(*dstPath));
+	return 0;
+}
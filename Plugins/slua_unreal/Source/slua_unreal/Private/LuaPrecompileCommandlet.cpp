@@ -0,0 +1,43 @@
+// Tencent is pleased to support the open source community by making sluaunreal available.
+
+// Copyright (C) 2018 THL A29 Limited, a Tencent company. All rights reserved.
+// Licensed under the BSD 3-Clause License (the "License");
+// you may not use this file except in compliance with the License. You may obtain a copy of the License at
+
+// https://opensource.org/licenses/BSD-3-Clause
+
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and limitations under the License.
+
+#include "LuaPrecompileCommandlet.h"
+#include "LuaBytecodeCache.h"
+#include "Log.h"
+#include "Misc/Paths.h"
+#include "Misc/Parse.h"
+#include "HAL/FileManager.h"
+
+int32 ULuaPrecompileCommandlet::Main(const FString& Params)
+{
+	FString srcDir = FPaths::ProjectContentDir() / TEXT("Lua");
+	FString dstDir = slua::LuaBytecodeCache::getShippedDir();
+	FParse::Value(*Params, TEXT("Source="), srcDir);
+	FParse::Value(*Params, TEXT("Output="), dstDir);
+
+	// remove bytecode of old sources, only files written by this commandlet
+	TArray<FString> oldFiles;
+	IFileManager::Get().FindFiles(oldFiles, *(dstDir / TEXT("*.luac")), true, false);
+	for (const FString& file : oldFiles)
+		IFileManager::Get().Delete(*(dstDir / file));
+	IFileManager::Get().MakeDirectory(*dstDir, true);
+
+	int32 failed;
+	int32 count = slua::LuaBytecodeCache::precompile(srcDir, dstDir, failed);
+	slua::Log::Log("Precompiled %d lua files to %s", count, TCHAR_TO_UTF8(*dstDir));
+	if (failed > 0) {
+		slua::Log::Error("Failed to precompile %d lua files", failed);
+		return 1;
+	}
+	return 0;
+}
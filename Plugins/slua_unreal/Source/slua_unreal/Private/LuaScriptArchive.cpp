@@ -0,0 +1,214 @@
+// Tencent is pleased to support the open source community by making sluaunreal available.
+
+// Copyright (C) 2018 THL A29 Limited, a Tencent company. All rights reserved.
+// Licensed under the BSD 3-Clause License (the "License");
+// you may not use this file except in compliance with the License. You may obtain a copy of the License at
+
+// https://opensource.org/licenses/BSD-3-Clause
+
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and limitations under the License.
+
+#include "LuaScriptArchive.h"
+#include "Log.h"
+#include "HAL/PlatformFilemanager.h"
+#include "HAL/FileManager.h"
+#include "Async/MappedFileHandle.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Misc/Compression.h"
+#include "Hash/CityHash.h"
+#include "Runtime/Launch/Resources/Version.h"
+
+#if (ENGINE_MINOR_VERSION>=22) && (ENGINE_MAJOR_VERSION>=4)
+#define SLUA_ARCHIVE_COMPRESSION NAME_Zlib
+#else
+#define SLUA_ARCHIVE_COMPRESSION COMPRESS_ZLIB
+#endif
+
+namespace slua {
+
+	namespace {
+		const uint32 ArchiveMagic = 0x4b504c53; // "SLPK"
+		const uint32 ArchiveVersion = 1;
+
+		uint64 hashName(const char* name, uint32 len) {
+			return CityHash64(name, len);
+		}
+	}
+
+	LuaScriptArchivePtr LuaScriptArchive::open(const FString& path)
+	{
+		LuaScriptArchivePtr archive = MakeShareable(new LuaScriptArchive());
+		archive->path = path;
+		IPlatformFile& platformFile = FPlatformFileManager::Get().GetPlatformFile();
+		archive->mappedFile = platformFile.OpenMapped(*path);
+		if (archive->mappedFile)
+			archive->mappedRegion = archive->mappedFile->MapRegion(0, archive->mappedFile->GetFileSize());
+		if (archive->mappedRegion) {
+			archive->data = archive->mappedRegion->GetMappedPtr();
+			archive->size = archive->mappedRegion->GetMappedSize();
+		}
+		else if (FFileHelper::LoadFileToArray(archive->fileData, *path, FILEREAD_Silent)) {
+			archive->data = archive->fileData.GetData();
+			archive->size = archive->fileData.Num();
+		}
+
+		if (!archive->data)
+			return nullptr;
+		if (!archive->init()) {
+			Log::Error("Invalid lua archive %s", TCHAR_TO_UTF8(*path));
+			return nullptr;
+		}
+		return archive;
+	}
+
+	LuaScriptArchive::~LuaScriptArchive()
+	{
+		delete mappedRegion;
+		delete mappedFile;
+	}
+
+	bool LuaScriptArchive::init()
+	{
+		if (!data || size < (int64)sizeof(Header))
+			return false;
+		const Header* header = (const Header*)data;
+		if (header->magic != ArchiveMagic || header->version != ArchiveVersion)
+			return false;
+		if ((int64)sizeof(Header) + (int64)header->count * sizeof(Entry) > size)
+			return false;
+		entries = (const Entry*)(data + sizeof(Header));
+		count = header->count;
+		// check ranges once, find can trust entries after
+		for (int32 i = 0; i < count; i++) {
+			const Entry& e = entries[i];
+			if ((int64)e.nameOffset + e.nameLen > size || (int64)e.offset + e.size > size)
+				return false;
+			// uncompressed entry is read in place with rawSize
+			if (!(e.flags & Compressed) && e.rawSize != e.size)
+				return false;
+		}
+		return true;
+	}
+
+	bool LuaScriptArchive::find(const char* module, LuaScriptBuffer& out) const
+	{
+		uint32 len = strlen(module);
+		uint64 hash = hashName(module, len);
+		// lower bound of hash
+		int32 lo = 0, hi = count;
+		while (lo < hi) {
+			int32 mid = (lo + hi) / 2;
+			if (entries[mid].hash < hash) lo = mid + 1;
+			else hi = mid;
+		}
+		for (int32 i = lo; i < count && entries[i].hash == hash; i++) {
+			const Entry& e = entries[i];
+			if (e.nameLen != len || FMemory::Memcmp(data + e.nameOffset, module, len) != 0)
+				continue;
+
+			if (e.flags & Compressed) {
+				out.owned.Reset(new uint8[e.rawSize]);
+				if (!FCompression::UncompressMemory(SLUA_ARCHIVE_COMPRESSION, out.owned.Get(), e.rawSize, data + e.offset, e.size)) {
+					out.owned.Reset();
+					return false;
+				}
+				out.data = out.owned.Get();
+			}
+			else
+				out.data = data + e.offset;
+			out.len = e.rawSize;
+			out.archived = true;
+			out.filepath = path / FString(UTF8_TO_TCHAR(module)).Replace(TEXT("."), TEXT("/"))
+				+ ((e.flags & Bytecode) ? TEXT(".luac") : TEXT(".lua"));
+			return true;
+		}
+		return false;
+	}
+
+	bool LuaScriptArchive::pack(const FString& srcDir, const FString& dstPath, bool compress)
+	{
+		struct PackFile {
+			FString module;
+			FTCHARToUTF8 name;
+			uint64 hash;
+			bool bytecode;
+			TArray<uint8> content;
+			uint32 rawSize;
+			PackFile(const FString& m) :module(m), name(*m), hash(0), bytecode(false), rawSize(0) {}
+		};
+
+		TArray<FString> files;
+		IFileManager::Get().FindFilesRecursive(files, *srcDir, TEXT("*.lua*"), true, false);
+		// .lua is preferred to .luac of same module
+		files.Sort([](const FString& a, const FString& b) { return a < b; });
+
+		TArray<TUniquePtr<PackFile>> packFiles;
+		TSet<FString> modules;
+		FString root = FPaths::ConvertRelativePathToFull(srcDir);
+		for (FString& file : files) {
+			FString ext = FPaths::GetExtension(file);
+			if (ext != TEXT("lua") && ext != TEXT("luac"))
+				continue;
+			FString relative = FPaths::ConvertRelativePathToFull(file);
+			FPaths::MakePathRelativeTo(relative, *(root / TEXT("")));
+			FString module = FPaths::ChangeExtension(relative, TEXT("")).Replace(TEXT("/"), TEXT("."));
+			if (modules.Contains(module))
+				continue;
+			modules.Add(module);
+
+			TUniquePtr<PackFile> pf(new PackFile(module));
+			if (!FFileHelper::LoadFileToArray(pf->content, *file)) {
+				Log::Error("Can't read %s", TCHAR_TO_UTF8(*file));
+				return false;
+			}
+			pf->hash = hashName(pf->name.Get(), pf->name.Length());
+			pf->bytecode = ext == TEXT("luac");
+			pf->rawSize = pf->content.Num();
+			if (compress && pf->rawSize > 0) {
+				int32 bound = FCompression::CompressMemoryBound(SLUA_ARCHIVE_COMPRESSION, pf->rawSize);
+				TArray<uint8> compressed;
+				compressed.SetNumUninitialized(bound);
+				int32 compressedSize = bound;
+				// keep raw content if compression save nothing
+				if (FCompression::CompressMemory(SLUA_ARCHIVE_COMPRESSION, compressed.GetData(), compressedSize, pf->content.GetData(), pf->rawSize)
+					&& compressedSize < (int32)pf->rawSize) {
+					compressed.SetNum(compressedSize);
+					pf->content = MoveTemp(compressed);
+				}
+			}
+			packFiles.Add(MoveTemp(pf));
+		}
+		packFiles.Sort([](const TUniquePtr<PackFile>& a, const TUniquePtr<PackFile>& b) { return a->hash < b->hash; });
+
+		uint32 nameOffset = sizeof(Header) + packFiles.Num() * sizeof(Entry);
+		uint32 offset = nameOffset;
+		for (auto& pf : packFiles) offset += pf->name.Length();
+
+		TArray<uint8> out;
+		Header header = { ArchiveMagic, ArchiveVersion, (uint32)packFiles.Num(), 0 };
+		out.Append((const uint8*)&header, sizeof(header));
+		for (auto& pf : packFiles) {
+			Entry e;
+			e.hash = pf->hash;
+			e.nameOffset = nameOffset;
+			e.nameLen = pf->name.Length();
+			e.offset = offset;
+			e.size = pf->content.Num();
+			e.rawSize = pf->rawSize;
+			e.flags = (e.size != e.rawSize ? Compressed : 0) | (pf->bytecode ? Bytecode : 0);
+			out.Append((const uint8*)&e, sizeof(e));
+			nameOffset += e.nameLen;
+			offset += e.size;
+		}
+		for (auto& pf : packFiles)
+			out.Append((const uint8*)pf->name.Get(), pf->name.Length());
+		for (auto& pf : packFiles)
+			out.Append(pf->content);
+
+		return FFileHelper::SaveArrayToFile(out, *dstPath);
+	}
+}
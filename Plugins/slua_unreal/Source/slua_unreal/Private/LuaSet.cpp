@@ -0,0 +1,312 @@
+// Tencent is pleased to support the open source community by making sluaunreal available.
+
+// Copyright (C) 2018 THL A29 Limited, a Tencent company. All rights reserved.
+// Licensed under the BSD 3-Clause License (the "License"); 
+// you may not use this file except in compliance with the License. You may obtain a copy of the License at
+
+// https://opensource.org/licenses/BSD-3-Clause
+
+// Unless required by applicable law or agreed to in writing, 
+// software distributed under the License is distributed on an "AS IS" BASIS, 
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. 
+// See the License for the specific language governing permissions and limitations under the License.
+
+#include "LuaSet.h"
+#include "LuaObject.h"
+#include "SluaLib.h"
+#include "LuaState.h"
+#include "LuaReference.h"
+
+namespace slua {
+
+    void LuaSet::reg(lua_State* L) {
+        SluaUtil::reg(L,"Set",__ctor);
+        SluaUtil::reg(L,"SetFromTable",FromTable);
+    }
+
+    void LuaSet::clone(FScriptSet* dest, UProperty* p, const FScriptSet* src) {
+        if(!src || src->Num()==0)
+            return;
+
+        FScriptSetHelper dstHelper = FScriptSetHelper::CreateHelperFormElementProperty(p, dest);
+        FScriptSetHelper srcHelper = FScriptSetHelper::CreateHelperFormElementProperty(p, src);
+        for (int32 index = 0; index < srcHelper.GetMaxIndex(); index++) {
+            if (srcHelper.IsValidIndex(index))
+                dstHelper.AddElement(srcHelper.GetElementPtr(index));
+        }
+    }
+
+    void LuaSet::fillFromTable(lua_State* L, int p, FScriptSetHelper& helper) {
+        p = lua_absindex(L, p);
+        UProperty* inner = helper.GetElementProperty();
+        auto checker = LuaObject::getChecker(inner);
+        if (!checker) {
+            FString tn = inner->GetClass()->GetName();
+            luaL_error(L, "unsupport set element type %s", TCHAR_TO_UTF8(*tn));
+        }
+        FDefaultConstructedPropertyElement tempElement(inner);
+        auto elementPtr = tempElement.GetObjAddress();
+        int n = (int)lua_rawlen(L, p);
+        for (int i = 1; i <= n; i++) {
+            lua_rawgeti(L, p, i);
+            checker(L, inner, (uint8*)elementPtr, lua_gettop(L));
+            helper.AddElement(elementPtr);
+            lua_pop(L, 1);
+        }
+    }
+
+	LuaSet::LuaSet(UProperty* p, FScriptSet* buf, bool byMove)
+		: inner(p)
+		, set(new FScriptSet())
+		, prop(nullptr)
+		, propObj(nullptr)
+		, helper(FScriptSetHelper::CreateHelperFormElementProperty(p, set))
+		, movable(false)
+    {
+		// take storage of temporary set, no element copied
+		if (byMove && buf)
+			set->MoveAssign(*buf, helper.SetLayout);
+		else
+			clone(set, p, buf);
+    }
+
+	LuaSet::LuaSet(USetProperty* p, UObject* obj)
+		: inner(p->ElementProp)
+		, set(p->ContainerPtrToValuePtr<FScriptSet>(obj))
+		, prop(p)
+		, propObj(obj)
+		, helper(p, set)
+		, movable(false)
+	{
+	}
+
+    LuaSet::~LuaSet() {
+		if (!propObj)
+		{
+			clear();
+			if (!prop) SafeDelete(set);
+		}
+
+		inner = nullptr;
+		prop = nullptr;
+		propObj = nullptr;
+    }
+
+    void LuaSet::clear() {
+        if(!inner) return;
+        helper.EmptyElements();
+    }
+
+    void LuaSet::AddReferencedObjects( FReferenceCollector& Collector )
+    {
+        Collector.AddReferencedObject(inner);
+		if (prop) Collector.AddReferencedObject(prop);
+		if (propObj) Collector.AddReferencedObject(propObj);
+
+        bool changed = false;
+        for (int32 index = 0; index < helper.GetMaxIndex(); index++) {
+            if (helper.IsValidIndex(index))
+                changed |= LuaReference::addRefByProperty(Collector, inner, helper.GetElementPtr(index));
+        }
+        if (changed) helper.Rehash();
+    }
+
+    // find index of element by lua value at p, numeric and FString element are hashed
+    // and compared without constructing a temporary element
+    int32 LuaSet::findIndex(lua_State* L, int p) {
+        UProperty* elementProp = inner;
+        if (elementProp->IsA<UNumericProperty>()) {
+            // numeric element is 8 bytes at most, check it into stack buffer
+            uint64 elementBuf = 0;
+            LuaObject::getChecker(elementProp)(L, elementProp, (uint8*)&elementBuf, p);
+            return set->FindIndex(&elementBuf, helper.SetLayout,
+                [elementProp](const void* e) { return elementProp->GetValueTypeHash(e); },
+                [elementProp](const void* a, const void* b) { return elementProp->Identical(a, b); });
+        }
+        else if (elementProp->IsA<UStrProperty>()) {
+            // hash and compare TCHAR string same as GetTypeHash and operator== of FString
+            FUTF8ToTCHAR str(LuaObject::checkValue<const char*>(L, p));
+            return set->FindIndex(str.Get(), helper.SetLayout,
+                [](const void* e) { return FCrc::Strihash_DEPRECATED((const TCHAR*)e); },
+                [](const void* a, const void* b) { return FCString::Stricmp((const TCHAR*)a, **(const FString*)b) == 0; });
+        }
+
+        auto checker = LuaObject::getChecker(elementProp);
+        if (!checker) {
+            FString tn = elementProp->GetClass()->GetName();
+            luaL_error(L, "unsupport set element type %s", TCHAR_TO_UTF8(*tn));
+        }
+        FDefaultConstructedPropertyElement tempElement(elementProp);
+        auto elementPtr = tempElement.GetObjAddress();
+        checker(L, elementProp, (uint8*)elementPtr, p);
+        return set->FindIndex(elementPtr, helper.SetLayout,
+            [elementProp](const void* e) { return elementProp->GetValueTypeHash(e); },
+            [elementProp](const void* a, const void* b) { return elementProp->Identical(a, b); });
+    }
+
+    void LuaSet::moveOrClone(UProperty* destInner, FScriptSet* dest) {
+        bool move = movable;
+        movable = false;
+        // only set owned by lua can be moved, to an empty dest with same element type
+        if (move && !prop && dest->Num() == 0
+            && destInner->GetClass() == inner->GetClass() && destInner->ElementSize == inner->ElementSize) {
+            dest->MoveAssign(*set, helper.SetLayout);
+            return;
+        }
+        clone(dest, destInner, set);
+    }
+
+    int LuaSet::push(lua_State* L, UProperty* inner, FScriptSet* data, bool byMove) {
+        LuaSet* luaSet = new LuaSet(inner, data, byMove);
+		return LuaObject::pushType(L, luaSet, "LuaSet", setupMT, gc);
+    }
+
+	int LuaSet::push(lua_State* L, USetProperty* prop, UObject* obj) {
+		auto scriptSet = prop->ContainerPtrToValuePtr<FScriptSet>(obj);
+		if (LuaObject::getFromCache(L, scriptSet, "LuaSet")) return 1;
+		LuaSet* luaSet = new LuaSet(prop, obj);
+		int r = LuaObject::pushType(L, luaSet, "LuaSet", setupMT, gc);
+		if (r) LuaObject::cacheObj(L, luaSet->set);
+		return 1;
+	}
+
+    int LuaSet::__ctor(lua_State* L) {
+		auto type = (EPropertyClass)LuaObject::checkValue<int>(L, 1);
+		auto cls = LuaObject::checkValueOpt<UClass*>(L, 2, nullptr);
+        if (type == EPropertyClass::Object && !cls)
+            luaL_error(L, "Set of UObject should have secend parameter is UClass");
+        auto inner = PropertyProto::getProperty({ type, cls });
+        if (!inner)
+            luaL_error(L, "unsupport set element type %d", (int)type);
+		return push(L, inner, nullptr);
+    }
+
+    // slua.SetFromTable(t,type[,cls]), create set from lua table in one call
+    int LuaSet::FromTable(lua_State* L) {
+        luaL_checktype(L, 1, LUA_TTABLE);
+        auto type = (EPropertyClass)LuaObject::checkValue<int>(L, 2);
+        auto cls = LuaObject::checkValueOpt<UClass*>(L, 3, nullptr);
+        if (type == EPropertyClass::Object && !cls)
+            luaL_error(L, "Set of UObject should have third parameter is UClass");
+        auto inner = PropertyProto::getProperty({ type, cls });
+        if (!inner)
+            luaL_error(L, "unsupport set element type %d", (int)type);
+        LuaSet* luaSet = new LuaSet(inner, nullptr);
+        LuaObject::pushType(L, luaSet, "LuaSet", setupMT, gc);
+        fillFromTable(L, 1, luaSet->helper);
+        return 1;
+    }
+
+    int LuaSet::ToTable(lua_State* L) {
+        CheckUD(LuaSet, L, 1);
+        auto& helper = UD->helper;
+        lua_createtable(L, helper.Num(), 0);
+        int n = 1;
+        for (int32 index = 0; index < helper.GetMaxIndex(); index++) {
+            if (!helper.IsValidIndex(index)) continue;
+            LuaObject::push(L, UD->inner, helper.GetElementPtr(index));
+            lua_rawseti(L, -2, n++);
+        }
+        return 1;
+    }
+
+    int LuaSet::Num(lua_State* L) {
+        CheckUD(LuaSet, L, 1);
+        return LuaObject::push(L, UD->helper.Num());
+    }
+
+    int LuaSet::Contains(lua_State* L) {
+        CheckUD(LuaSet, L, 1);
+        return LuaObject::push(L, UD->findIndex(L, 2) != INDEX_NONE);
+    }
+
+    int LuaSet::Add(lua_State* L) {
+        CheckUD(LuaSet, L, 1);
+        // already in set
+        if (UD->findIndex(L, 2) != INDEX_NONE)
+            return LuaObject::push(L, false);
+        auto checker = LuaObject::getChecker(UD->inner);
+        FDefaultConstructedPropertyElement tempElement(UD->inner);
+        auto elementPtr = tempElement.GetObjAddress();
+        checker(L, UD->inner, (uint8*)elementPtr, 2);
+        UD->helper.AddElement(elementPtr);
+        return LuaObject::push(L, true);
+    }
+
+    int LuaSet::Remove(lua_State* L) {
+        CheckUD(LuaSet, L, 1);
+        int32 index = UD->findIndex(L, 2);
+        if (index == INDEX_NONE)
+            return LuaObject::push(L, false);
+        UD->helper.RemoveAt(index);
+        return LuaObject::push(L, true);
+    }
+
+    // set:Move(), mark set to be moved to next ufunction param instead of copied,
+    // set will be empty after that call, return self
+    int LuaSet::Move(lua_State* L) {
+        CheckUD(LuaSet, L, 1);
+        UD->movable = true;
+        lua_pushvalue(L, 1);
+        return 1;
+    }
+
+    int LuaSet::Clear(lua_State* L) {
+        CheckUD(LuaSet, L, 1);
+        UD->clear();
+        return 0;
+    }
+
+	// stateless iterator, control variable is sparse index of set
+	// so nothing allocated for each loop
+	int LuaSet::Pairs(lua_State* L) {
+		CheckUD(LuaSet, L, 1);
+		lua_pushcfunction(L, LuaSet::Enumerable);
+		lua_pushvalue(L, 1);
+		LuaObject::pushNil(L);
+		return 3;
+	}
+
+	int LuaSet::Enumerable(lua_State* L) {
+		CheckUD(LuaSet, L, 1);
+		auto& helper = UD->helper;
+		int32 index = lua_isnil(L, 2) ? 0 : LuaObject::checkValue<int>(L, 2) + 1;
+		for (; index < helper.GetMaxIndex(); index++) {
+			if (helper.IsValidIndex(index)) {
+				LuaObject::push(L, index);
+				LuaObject::push(L, UD->inner, helper.GetElementPtr(index));
+				return 2;
+			}
+		}
+		return 0;
+	}
+
+	int LuaSet::__len(lua_State* L) {
+		return Num(L);
+	}
+
+    int LuaSet::setupMT(lua_State* L) {
+        LuaObject::setupMTSelfSearch(L);
+
+		RegMetaMethod(L, Pairs);
+        RegMetaMethod(L, Num);
+        RegMetaMethod(L, Contains);
+        RegMetaMethod(L, Add);
+        RegMetaMethod(L, Remove);
+        RegMetaMethod(L, Clear);
+        RegMetaMethod(L, Move);
+        RegMetaMethod(L, ToTable);
+
+		RegMetaMethodByName(L, "__pairs", Pairs);
+		RegMetaMethodByName(L, "__len", __len);
+
+        return 0;
+    }
+
+    int LuaSet::gc(lua_State* L) {
+        CheckUD(LuaSet, L, 1);
+		LuaObject::deleteFGCObject(L, UD);
+        return 0;
+    }
+
+}
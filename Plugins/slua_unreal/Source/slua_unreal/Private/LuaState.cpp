@@ -26,11 +26,18 @@
 #include "LuaWrapper.h"
 #include "LuaArray.h"
 #include "LuaMap.h"
+#include "LuaSet.h"
 #include "LuaSocketWrap.h"
 #include "LuaMemoryProfile.h"
 #include "HAL/RunnableThread.h"
 #include "GameDelegates.h"
 #include "LuaActor.h"
+#include "LuaTickManager.h"
+#include "LuaCoroutine.h"
+#include "LuaAsyncLoader.h"
+#include "LuaBytecodeCache.h"
+#include "Async/Async.h"
+#include "HAL/FileManager.h"
 
 namespace slua {
 
@@ -95,14 +102,15 @@ namespace slua {
     int LuaState::loader(lua_State* L) {
         LuaState* state = LuaState::get(L);
         const char* fn = lua_tostring(L,1);
-        uint32 len;
-        FString filepath;
-        if(uint8* buf = state->loadFile(fn,len,filepath)) {
-            AutoDeleteArray<uint8> defer(buf);
-
+        // loaded file may change resolved paths
+        state->resolveCache.Empty();
+        if(state->loadPreloaded(fn))
+            return 1;
+        LuaScriptBuffer file;
+        if(state->loadFile(fn,file)) {
             char chunk[256];
-            snprintf(chunk,256,"@%s",TCHAR_TO_UTF8(*filepath));
-            if(luaL_loadbuffer(L,(const char*)buf,len,chunk)==0) {
+            snprintf(chunk,256,"%s",TCHAR_TO_UTF8(*LuaBytecodeCache::getChunkName(file.filepath)));
+            if(state->loadChunk(file.data,file.len,chunk)==0) {
                 return 1;
             }
             else {
@@ -116,22 +124,119 @@ namespace slua {
         return 0;
     }
     
-    uint8* LuaState::loadFile(const char* fn,uint32& len,FString& filepath) {
-        if(loadFileDelegate) return loadFileDelegate(fn,len,filepath);
-        return nullptr;
+    bool LuaState::loadFile(const char* fn,LuaScriptBuffer& out) {
+        return readFile(archives,loadFileDelegate,fn,out);
+    }
+
+    bool LuaState::readFile(const TArray<LuaScriptArchivePtr>& archives,LoadFileDelegate delegate,const char* fn,LuaScriptBuffer& out) {
+        for(int32 i=archives.Num()-1;i>=0;i--) {
+            if(archives[i]->find(fn,out)) return true;
+        }
+        if(!delegate) return false;
+        uint8* buf = delegate(fn,out.len,out.filepath);
+        out.owned.Reset(buf);
+        out.data = buf;
+        return buf!=nullptr;
+    }
+
+    bool LuaState::mountArchive(const FString& path) {
+        auto archive = LuaScriptArchive::open(path);
+        if(!archive.IsValid()) return false;
+        archives.Add(archive);
+        return true;
+    }
+
+    int LuaState::loadChunk(const uint8* buf,uint32 len,const char* chunk) {
+        if(bytecodeCache) return LuaBytecodeCache::load(L,buf,len,chunk);
+        return luaL_loadbuffer(L,(const char*)buf,len,chunk);
+    }
+
+    static int chunkWriter(lua_State* L, const void* p, size_t sz, void* ud) {
+        ((TArray<uint8>*)ud)->Append((const uint8*)p, sz);
+        return 0;
+    }
+
+    void LuaState::preloadModules(const TArray<FString>& modules) {
+        if(!preloadQueue.IsValid()) return;
+        LoadFileDelegate delegate = loadFileDelegate;
+        TArray<LuaScriptArchivePtr> mounted = archives;
+        bool useCache = bytecodeCache;
+        // files are only edited while game running in editor
+        bool watchFile = GIsEditor;
+        auto queue = preloadQueue;
+        for(auto& module:modules) {
+            if(pendingPreloads.Contains(module) || preloadedChunks.Contains(module))
+                continue;
+            pendingPreloads.Add(module);
+            AsyncTask(ENamedThreads::AnyThread,[=]() {
+                PreloadedChunkPtr chunk = MakeShareable(new PreloadedChunk);
+                chunk->module = module;
+                LuaScriptBuffer file;
+                if(readFile(mounted,delegate,TCHAR_TO_UTF8(*module),file)) {
+                    chunk->filepath = file.filepath;
+                    chunk->watched = watchFile && !file.archived;
+                    if(chunk->watched) chunk->timestamp = IFileManager::Get().GetTimeStamp(*chunk->filepath);
+                    char name[256];
+                    snprintf(name,256,"%s",TCHAR_TO_UTF8(*LuaBytecodeCache::getChunkName(chunk->filepath)));
+                    // compile in scratch state, errors are reported by loading on game thread,
+                    // cache files are only written by game thread
+                    lua_State* scratch = luaL_newstate();
+                    int status = useCache ? LuaBytecodeCache::load(scratch,file.data,file.len,name,false)
+                        : luaL_loadbuffer(scratch,(const char*)file.data,file.len,name);
+                    if(status==0) lua_dump(scratch,chunkWriter,&chunk->bytecode,0);
+                    lua_close(scratch);
+                }
+                queue->Enqueue(chunk);
+            });
+        }
+    }
+
+    bool LuaState::loadPreloaded(const char* fn) {
+        if(!preloadQueue.IsValid()) return false;
+        PreloadedChunkPtr chunk;
+        while(preloadQueue->Dequeue(chunk)) {
+            // dropped if loaded before compiled, or file changed while compiling
+            if(pendingPreloads.Remove(chunk->module) && chunk->bytecode.Num()>0 && !isStale(*chunk))
+                preloadedChunks.Add(chunk->module,chunk);
+        }
+
+        FString module = UTF8_TO_TCHAR(fn);
+        pendingPreloads.Remove(module);
+        if(!preloadedChunks.RemoveAndCopyValue(module,chunk))
+            return false;
+        char name[256];
+        snprintf(name,256,"%s",TCHAR_TO_UTF8(*LuaBytecodeCache::getChunkName(chunk->filepath)));
+        if(luaL_loadbuffer(L,(const char*)chunk->bytecode.GetData(),chunk->bytecode.Num(),name)==0)
+            return true;
+        lua_pop(L,1);
+        return false;
+    }
+
+    bool LuaState::isStale(const PreloadedChunk& chunk) {
+        // file changed after read, archived file or file of non-editor build isn't checked
+        return chunk.watched && IFileManager::Get().GetTimeStamp(*chunk.filepath)!=chunk.timestamp;
     }
 
     LuaState* LuaState::mainState = nullptr;
     TMap<int,LuaState*> stateMapFromIndex;
+    // first opened state of each name
+    TMap<FString,LuaState*> stateMapFromName;
     static int StateIndex = 0;
+    // slots of closed state, reused by next state
+    static TArray<LuaStateSlot*> freeSlots;
 
 	LuaState::LuaState(const char* name)
 		:loadFileDelegate(nullptr)
 		, L(nullptr)
 		, cacheObjRef(LUA_NOREF)
+		, errorRef(LUA_NOREF)
 		, stackCount(0)
 		, si(0)
+		, slot(nullptr)
 		, deadLoopCheck(nullptr)
+		, coScheduler(nullptr)
+		// editor compiles edited sources often, cache would grow without bound
+		, bytecodeCache(!GIsEditor)
     {
         if(name) stateName=UTF8_TO_TCHAR(name);
     }
@@ -148,11 +253,8 @@ namespace slua {
     }
 
     LuaState* LuaState::get(const FString& name) {
-        for(auto& pair:stateMapFromIndex) {
-            auto state = pair.Value;
-            if(state->stateName==name)
-                return state;
-        }
+        auto it = stateMapFromName.Find(name);
+        if(it) return *it;
         return nullptr;
     }
 
@@ -168,14 +270,35 @@ namespace slua {
     void LuaState::close() {
         if(mainState==this) mainState = nullptr;
 
-		releaseAllLink();
-        
         if(L) {
+            LuaTickManager::cleanup(this, nullptr);
+            SafeDelete(coScheduler);
+            preloadQueue.Reset();
+            pendingPreloads.Empty();
+            preloadedChunks.Empty();
+            resolveCache.Empty();
+            LuaBase::removeClassModules(this);
             lua_close(L);
 			GUObjectArray.RemoveUObjectDeleteListener(this);
 			FCoreUObjectDelegates::GetPostGarbageCollect().Remove(pgcHandler);
 			FWorldDelegates::OnWorldCleanup.Remove(wcHandler);
+			FTicker::GetCoreTicker().RemoveTicker(tickHandler);
             stateMapFromIndex.Remove(si);
+            if(stateMapFromName.FindRef(stateName)==this) {
+                stateMapFromName.Remove(stateName);
+                // other state with same name
+                for(auto& pair:stateMapFromIndex) {
+                    if(pair.Value->stateName==stateName) {
+                        stateMapFromName.Add(stateName,pair.Value);
+                        break;
+                    }
+                }
+            }
+            // invalidate all handles to this state
+            slot->state = nullptr;
+            slot->generation++;
+            freeSlots.Add(slot);
+            slot = nullptr;
             L=nullptr;
         }
 
@@ -199,7 +322,6 @@ namespace slua {
         stackCount = 0;
         si = ++StateIndex;
 
-		propLinks.Empty();
 		classMap.clear();
 		objRefs.Empty();
 
@@ -216,6 +338,9 @@ namespace slua {
         // bind this to L
         *((void**)lua_getextraspace(L)) = this;
         stateMapFromIndex.Add(si,this);
+        if(!stateMapFromName.Contains(stateName)) stateMapFromName.Add(stateName,this);
+        slot = freeSlots.Num() > 0 ? freeSlots.Pop(false) : new LuaStateSlot{ nullptr, 1 };
+        slot->state = this;
 
         // init obj cache table
         lua_newtable(L);
@@ -226,6 +351,9 @@ namespace slua {
         // register it
         cacheObjRef = luaL_ref(L,LUA_REGISTRYINDEX);
 
+        lua_pushcfunction(L,error);
+        errorRef = luaL_ref(L,LUA_REGISTRYINDEX);
+
         ensure(lua_gettop(L)==0);
         
         luaL_openlibs(L);
@@ -261,15 +389,23 @@ namespace slua {
 		LuaSocket::init(L);
         LuaObject::init(L);
         SluaUtil::openLib(L);
+        LuaCoroutineScheduler::reg(L);
+        LuaAsyncLoader::reg(L);
         LuaClass::reg(L);
         LuaArray::reg(L);
         LuaMap::reg(L);
+        LuaSet::reg(L);
 
 		// disable gc in main thread
 		if (enableMultiThreadGC) lua_gc(L, LUA_GCSTOP, 0);
 
         lua_settop(L,0);
 
+		gcSched.reset(L);
+		coScheduler = new LuaCoroutineScheduler(L);
+		preloadQueue = MakeShareable(new PreloadQueue);
+		tickHandler = FTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateRaw(this, &LuaState::onTick));
+
         return true;
     }
 
@@ -283,46 +419,6 @@ namespace slua {
 		loadFileDelegate = func;
 	}
 
-	static void* findParent(GenericUserData* parent) {
-		auto pp = parent;
-		while(true) {
-			if (!pp->parent)
-				break;
-			pp = reinterpret_cast<GenericUserData*>(pp->parent);
-		}
-		return pp;
-	}
-
-	void LuaState::linkProp(void* parent, void* prop) {
-		auto parentud = findParent(reinterpret_cast<GenericUserData*>(parent));
-		auto propud = reinterpret_cast<GenericUserData*>(prop);
-		propud->parent = parentud;
-		auto& propList = propLinks.FindOrAdd(parentud);
-		propList.Add(propud);
-	}
-
-	void LuaState::releaseLink(void* prop) {
-		auto propud = reinterpret_cast<GenericUserData*>(prop);
-		if (propud->flag & UD_AUTOGC) {
-			auto propListPtr = propLinks.Find(propud);
-			if (propListPtr) 
-				for (auto& cprop : *propListPtr) 
-					reinterpret_cast<GenericUserData*>(cprop)->flag |= UD_HADFREE;
-		} else {
-			propud->flag |= UD_HADFREE;
-			auto propListPtr = propLinks.Find(propud->parent);
-			if (propListPtr) 
-				propListPtr->Remove(propud);
-		}
-	}
-
-	void LuaState::releaseAllLink() {
-		for (auto& pair : propLinks) 
-			for (auto& prop : pair.Value) 
-				reinterpret_cast<GenericUserData*>(prop)->flag |= UD_HADFREE;
-		propLinks.Empty();
-	}
-
 	// engine will call this function on post gc
 	void LuaState::onEngineGC()
 	{
@@ -330,6 +426,7 @@ namespace slua {
 		for (ClassFunctionCache::CacheMap::TIterator it(classMap.cacheMap); it; ++it)
 			if (!it.Key().IsValid())
 				it.RemoveCurrent();
+		LuaVar::removeStaleCallPlans();
 		// really delete FGCObject
 		for (auto ptr : deferDelete)
 			delete ptr;
@@ -338,12 +435,96 @@ namespace slua {
 		Log::Log("Unreal engine GC, lua used %d KB",lua_gc(L, LUA_GCCOUNT, 0));
 	}
 
+	bool LuaState::onTick(float dtime)
+	{
+		if (!L) return true;
+		if (coScheduler) coScheduler->tick(dtime);
+		// gc stopped in main thread, collected in AddReferencedObjects
+		if (!enableMultiThreadGC)
+			gcSched.tick(L);
+		return true;
+	}
+
+	LuaGCScheduler::LuaGCScheduler()
+		: budgetMs(1.0f)
+		, memoryLimitKB(0)
+		, stepKB(0)
+		, debtKB(0)
+		, lastBytes(0)
+	{
+		FMemory::Memzero(lastStats);
+	}
+
+	namespace {
+		const int MinGCStepKB = 16;
+		const int MaxGCStepKB = 1024;
+
+		int64 luaMemoryBytes(lua_State* L) {
+			return (int64)lua_gc(L, LUA_GCCOUNT, 0) * 1024 + lua_gc(L, LUA_GCCOUNTB, 0);
+		}
+	}
+
+	void LuaGCScheduler::reset(lua_State* L)
+	{
+		stepKB = MinGCStepKB;
+		debtKB = 0;
+		lastBytes = luaMemoryBytes(L);
+		FMemory::Memzero(lastStats);
+	}
+
+	void LuaGCScheduler::tick(lua_State* L)
+	{
+		FMemory::Memzero(lastStats);
+		int64 bytes = luaMemoryBytes(L);
+		// allocation since last frame is the debt to pay
+		if (bytes > lastBytes)
+			debtKB += (int)((bytes - lastBytes) / 1024);
+
+		if (budgetMs > 0 && debtKB > 0) {
+			// step harder when memory is close to limit
+			int step = stepKB;
+			if (memoryLimitKB > 0) {
+				float usage = (float)(bytes / 1024) / memoryLimitKB;
+				if (usage > 0.75f)
+					step = FMath::Min(MaxGCStepKB, (int)(step * FMath::Min(usage * 4.0f, 8.0f)));
+			}
+
+			double start = FPlatformTime::Seconds();
+			double deadline = start + budgetMs / 1000.0;
+			bool cycleDone = false;
+			while (debtKB > 0 && !cycleDone) {
+				cycleDone = lua_gc(L, LUA_GCSTEP, step) != 0;
+				debtKB -= step;
+				lastStats.stepCount++;
+				if (FPlatformTime::Seconds() >= deadline)
+					break;
+			}
+			lastStats.stepTime = (FPlatformTime::Seconds() - start) * 1000.0;
+
+			// adapt step size, bigger step if debt can't be paid in budget
+			if (debtKB > 0)
+				stepKB = FMath::Min(MaxGCStepKB, stepKB * 2);
+			else if (lastStats.stepCount > 1)
+				stepKB = FMath::Max(MinGCStepKB, stepKB / 2);
+			// a finished cycle clears debt
+			if (cycleDone || debtKB < 0)
+				debtKB = 0;
+		}
+
+		lastBytes = luaMemoryBytes(L);
+		lastStats.freedBytes = FMath::Max<int64>(0, bytes - lastBytes);
+		lastStats.debtKB = debtKB;
+		lastStats.memoryKB = (int)(lastBytes / 1024);
+	}
+
 	void LuaState::onWorldCleanup(UWorld * World, bool bSessionEnded, bool bCleanupResources)
 	{
+		LuaTickManager::cleanup(this, World);
 		unlinkUObject(World);
 	}
 
     LuaVar LuaState::doBuffer(const uint8* buf,uint32 len, const char* chunk, LuaVar* pEnv) {
+        resolveCache.Empty();
         AutoStack g(L);
         int errfunc = pushErrorHandler(L);
 
@@ -374,15 +555,27 @@ namespace slua {
     }
 
     LuaVar LuaState::doFile(const char* fn, LuaVar* pEnv) {
-        uint32 len;
-        FString filepath;
-        if(uint8* buf=loadFile(fn,len,filepath)) {
+        resolveCache.Empty();
+        {
+            AutoStack g(L);
+            if(loadPreloaded(fn)) {
+                LuaVar f(L,-1);
+                return f.call();
+            }
+        }
+        LuaScriptBuffer file;
+        if(loadFile(fn,file)) {
             char chunk[256];
-            snprintf(chunk,256,"@%s",TCHAR_TO_UTF8(*filepath));
+            snprintf(chunk,256,"%s",TCHAR_TO_UTF8(*LuaBytecodeCache::getChunkName(file.filepath)));
 
-            LuaVar r = doBuffer( buf,len,chunk,pEnv );
-            delete[] buf;
-            return r;
+            AutoStack g(L);
+            if(loadChunk(file.data,file.len,chunk)) {
+                const char* err = lua_tostring(L,-1);
+                Log::Error("DoFile failed: %s",err);
+                return LuaVar();
+            }
+            LuaVar f(L,-1);
+            return f.call();
         }
         return LuaVar();
     }
@@ -436,7 +629,7 @@ namespace slua {
     }
 
 	int LuaState::_pushErrorHandler(lua_State* state) {
-        lua_pushcfunction(state,error);
+        lua_rawgeti(state,LUA_REGISTRYINDEX,errorRef);
         return lua_gettop(state);
     }
 
@@ -444,24 +637,36 @@ namespace slua {
         // push global table
         lua_pushglobaltable(L);
 
-        FString path(key);
-        FString left,right;
+        // walk segments of key in place
         LuaVar rt;
-        while(strSplit(path,".",&left,&right)) {
+        const char* seg = key;
+        while(*seg) {
             if(lua_type(L,-1)!=LUA_TTABLE) break;
-            lua_pushstring(L,TCHAR_TO_UTF8(*left));
+            const char* dot = strchr(seg,'.');
+            size_t len = dot ? dot-seg : strlen(seg);
+            lua_pushlstring(L,seg,len);
             lua_gettable(L,-2);
             rt.set(L,-1);
             lua_remove(L,-2);
-            if(rt.isNil()) break;
-            path = right;
+            if(rt.isNil() || !dot) break;
+            seg = dot+1;
         }
         lua_pop(L,1);
         return rt;
     }
 
+    LuaVar LuaState::resolve(const FString& key) {
+        if(LuaVar* v = resolveCache.Find(key))
+            return *v;
+        LuaVar rt = get(TCHAR_TO_UTF8(*key));
+        // nil isn't cached, it may be defined later
+        if(!rt.isNil()) resolveCache.Add(key,rt);
+        return rt;
+    }
+
 	bool LuaState::set(const char * key, LuaVar v)
 	{
+		resolveCache.Empty();
 		// push global table
 		AutoStack as(L);
 		lua_pushglobaltable(L);
@@ -598,14 +803,13 @@ namespace slua {
 
 	LuaScriptCallGuard::LuaScriptCallGuard(lua_State * L_)
 		:L(L_)
+		,ls(LuaState::get(L_))
 	{
-		auto ls = LuaState::get(L);
 		ls->deadLoopCheck->scriptEnter(this);
 	}
 
 	LuaScriptCallGuard::~LuaScriptCallGuard()
 	{
-		auto ls = LuaState::get(L);
 		ls->deadLoopCheck->scriptLeave();
 	}
 
@@ -0,0 +1,172 @@
+// Tencent is pleased to support the open source community by making sluaunreal available.
+
+// Copyright (C) 2018 THL A29 Limited, a Tencent company. All rights reserved.
+// Licensed under the BSD 3-Clause License (the "License");
+// you may not use this file except in compliance with the License. You may obtain a copy of the License at
+
+// https://opensource.org/licenses/BSD-3-Clause
+
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and limitations under the License.
+
+#include "LuaTickManager.h"
+#include "LuaState.h"
+#include "LuaBase.h"
+#include "Engine/World.h"
+#include "Engine/Level.h"
+
+namespace slua {
+
+	namespace {
+		typedef TTuple<LuaState*, UWorld*, ETickingGroup> TickManagerKey;
+		TMap<TickManagerKey, LuaTickManager*> tickManagers;
+
+		const char* DispatcherCode =
+			"local xpcall = xpcall\n"
+			"return function(selves, deltas, n, errhandler)\n"
+			"    for i = 1, n do\n"
+			"        local self = selves[i]\n"
+			"        xpcall(self.Tick, errhandler, self, deltas[i])\n"
+			"    end\n"
+			"end\n";
+
+		// golden ratio spread first tick of actors with same interval across frames
+		float staggerPhase(int32 serial) {
+			return FMath::Fractional(serial * 0.618034f);
+		}
+	}
+
+	void FLuaTickFunction::ExecuteTick(float DeltaTime, ELevelTick TickType, ENamedThreads::Type CurrentThread, const FGraphEventRef& MyCompletionGraphEvent)
+	{
+		if (manager) manager->tick(DeltaTime);
+	}
+
+	FString FLuaTickFunction::DiagnosticMessage()
+	{
+		return TEXT("LuaTickManager");
+	}
+
+	LuaTickManager* LuaTickManager::get(LuaState* ls, UWorld* world, ETickingGroup group)
+	{
+		if (!ls || !world) return nullptr;
+		TickManagerKey key(ls, world, group);
+		if (auto manager = tickManagers.Find(key))
+			return *manager;
+		auto manager = new LuaTickManager(ls, world, group);
+		tickManagers.Add(key, manager);
+		return manager;
+	}
+
+	void LuaTickManager::cleanup(LuaState* ls, UWorld* world)
+	{
+		for (auto it = tickManagers.CreateIterator(); it; ++it) {
+			if (it->Key.Get<0>() != ls || (world && it->Key.Get<1>() != world))
+				continue;
+			delete it->Value;
+			it.RemoveCurrent();
+		}
+	}
+
+	LuaTickManager::LuaTickManager(LuaState* ls, UWorld* world, ETickingGroup group)
+		: stateHandle(ls->handle())
+		, lastCount(0)
+		, ticking(false)
+	{
+		dispatcher = ls->doString(DispatcherCode);
+		selves = ls->createTable();
+		deltas = ls->createTable();
+
+		tickFunction.manager = this;
+		tickFunction.bCanEverTick = true;
+		tickFunction.bStartWithTickEnabled = true;
+		tickFunction.TickGroup = group;
+		tickFunction.RegisterTickFunction(world->PersistentLevel);
+	}
+
+	LuaTickManager::~LuaTickManager()
+	{
+		tickFunction.UnRegisterTickFunction();
+		tickFunction.manager = nullptr;
+		for (auto& entry : entries) {
+			if (entry.base) entry.base->tickManager = nullptr;
+		}
+	}
+
+	void LuaTickManager::add(LuaBase* base, float interval)
+	{
+		Entry entry;
+		entry.base = base;
+		entry.interval = FMath::Max(0.0f, interval);
+		entry.accum = entry.interval * staggerPhase(entries.Num());
+		entries.Add(entry);
+		base->tickManager = this;
+	}
+
+	void LuaTickManager::remove(LuaBase* base)
+	{
+		for (int32 i = 0; i < entries.Num(); i++) {
+			if (entries[i].base != base)
+				continue;
+			// entries can't be moved during tick, compact them after
+			if (ticking)
+				entries[i].base = nullptr;
+			else
+				entries.RemoveAtSwap(i);
+			break;
+		}
+		base->tickManager = nullptr;
+	}
+
+	void LuaTickManager::tick(float deltaTime)
+	{
+		LuaState* ls = stateHandle.get();
+		if (!ls || !dispatcher.isFunction()) return;
+		lua_State* L = ls->getLuaState();
+
+		AutoStack as(L);
+		ticking = true;
+		// pack due actors to selves and deltas
+		selves.push(L);
+		deltas.push(L);
+		int n = 0;
+		for (auto& entry : entries) {
+			if (!entry.base) continue;
+			entry.accum += deltaTime;
+			if (entry.accum < entry.interval)
+				continue;
+			float dt = entry.accum;
+			entry.accum = 0;
+			// skipped by tick LOD, time is accumulated in LOD
+			if (!entry.base->stepTickLOD(dt, dt))
+				continue;
+			n++;
+			entry.base->luaSelfTable.push(L);
+			lua_rawseti(L, -3, n);
+			lua_pushnumber(L, dt);
+			lua_rawseti(L, -2, n);
+		}
+		// release self tables packed last frame
+		for (int i = n + 1; i <= lastCount; i++) {
+			lua_pushnil(L);
+			lua_rawseti(L, -3, i);
+		}
+		lastCount = n;
+		lua_pop(L, 2);
+
+		if (n > 0) {
+			int errfunc = LuaState::pushErrorHandler(L);
+			dispatcher.push(L);
+			selves.push(L);
+			deltas.push(L);
+			lua_pushinteger(L, n);
+			lua_pushvalue(L, errfunc);
+			LuaScriptCallGuard g(L);
+			lua_pcall(L, 4, 0, errfunc);
+		}
+
+		ticking = false;
+		entries.RemoveAllSwap([](const Entry& entry) { return entry.base == nullptr; });
+	}
+}
@@ -23,6 +23,7 @@ void ULuaUserWidget::NativeConstruct()
 #else
 	bHasScriptImplementedTick = postInit("bHasScriptImplementedTick", false);
 #endif
+	initTickLOD(nullptr);
 }
 
 void ULuaUserWidget::NativeDestruct() {
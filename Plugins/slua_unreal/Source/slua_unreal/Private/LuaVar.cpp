@@ -27,7 +27,6 @@
 namespace slua {
 
     LuaVar::LuaVar()
-        :stateIndex(-1)
     {
         vars = nullptr;
         numOfVar = 0;
@@ -131,13 +130,12 @@ namespace slua {
 
     lua_State* LuaVar::getState() const
     {
-		auto ls = LuaState::get(stateIndex);
+		auto ls = stateHandle.get();
 		return ls ? ls->getLuaState() : nullptr;
     }
 
     void LuaVar::init(lua_State* l,int p,LuaVar::Type type) {
-        auto state = LuaState::get(l);
-        stateIndex = state->stateIndex();
+        stateHandle = LuaState::get(l)->handle();
         switch(type) {
         case LV_NIL:
             break;
@@ -147,12 +145,6 @@ namespace slua {
         case LV_NUMBER:
             set(lua_tonumber(l,p));
             break;
-		case LV_STRING: {
-			size_t len;
-			const char* buf = lua_tolstring(l, p, &len);
-			set(buf,len);
-			break;
-		}
         case LV_BOOL:
             set(!!lua_toboolean(l,p));
             break;
@@ -161,13 +153,12 @@ namespace slua {
             vars[0].ptr = lua_touserdata(l,p);
             vars[0].luatype = type;
             break;
+		case LV_STRING:
         case LV_FUNCTION: 
         case LV_TABLE:
         case LV_USERDATA:
             alloc(1);
-            lua_pushvalue(l,p);
-            vars[0].ref = new RefRef(l);
-            vars[0].luatype=type;
+            varRef(l,vars[0],p,type);
             break;
         case LV_TUPLE:
             ensure(p>0 && lua_gettop(l)>=p);
@@ -204,27 +195,17 @@ namespace slua {
                     }
                 }
                 break;
-			case LUA_TSTRING: {
-				vars[i].luatype = LV_STRING;
-				size_t len;
-				const char* buf = lua_tolstring(l, p, &len);
-				vars[i].s = new RefStr(buf,len);
+			case LUA_TSTRING:
+				varRef(l, vars[i], p, LV_STRING);
 				break;
-			}
             case LUA_TFUNCTION:
-                vars[i].luatype = LV_FUNCTION;
-                lua_pushvalue(l,p);
-                vars[i].ref = new RefRef(l);
+                varRef(l,vars[i],p,LV_FUNCTION);
                 break;
             case LUA_TTABLE:
-                vars[i].luatype = LV_TABLE;
-                lua_pushvalue(l,p);
-                vars[i].ref = new RefRef(l);
+                varRef(l,vars[i],p,LV_TABLE);
                 break;
 			case LUA_TUSERDATA:
-				vars[i].luatype = LV_USERDATA;
-				lua_pushvalue(l, p);
-				vars[i].ref = new RefRef(l);
+				varRef(l, vars[i], p, LV_USERDATA);
 				break;
 			case LUA_TLIGHTUSERDATA:
 				vars[i].luatype = LV_LIGHTUD;
@@ -242,37 +223,42 @@ namespace slua {
         free();
     }
 
-    LuaVar::RefRef::RefRef(lua_State* l) 
-        :LuaVar::Ref() 
-    {
-        ref=luaL_ref(l,LUA_REGISTRYINDEX);
-        stateIndex = LuaState::get(l)->stateIndex();
-    }
-
-    LuaVar::RefRef::~RefRef() {
-        if(LuaState::isValid(stateIndex)) {
-            auto state = LuaState::get(stateIndex);
-            luaL_unref(state->getLuaState(),LUA_REGISTRYINDEX,ref);
+    // hold value at p by registry ref
+    void LuaVar::varRef(lua_State* l,lua_var& tv,int p,Type t) {
+        if(t==LV_STRING) {
+            size_t len;
+            tv.ls.buf = lua_tolstring(l,p,&len);
+            tv.ls.length = len;
         }
+        lua_pushvalue(l,p);
+        tv.ref = luaL_ref(l,LUA_REGISTRYINDEX);
+        tv.luatype = t;
     }
 
     void LuaVar::free() {
+        lua_State* L = nullptr;
         for(size_t n=0;n<numOfVar;n++) {
-            if( (vars[n].luatype==LV_FUNCTION || vars[n].luatype==LV_TABLE || vars[n].luatype == LV_USERDATA)
-                && vars[n].ref->isValid() )
-                vars[n].ref->release();
+            if(vars[n].ref!=LUA_NOREF) {
+                // unref if state not closed
+                if(!L) L = getState();
+                if(L) luaL_unref(L,LUA_REGISTRYINDEX,vars[n].ref);
+            }
             else if(vars[n].luatype==LV_STRING)
                 vars[n].s->release();
         }
         numOfVar = 0;
-        delete[] vars;
+        if(vars!=&inlineVar) delete[] vars;
         vars = nullptr;
     }
 
     void LuaVar::alloc(int n) {
         if(n>0) {
-            vars = new lua_var[n];
+            vars = n==1 ? &inlineVar : new lua_var[n];
             numOfVar = n;
+            for(int i=0;i<n;i++) {
+                vars[i].ref = LUA_NOREF;
+                vars[i].luatype = LV_NIL;
+            }
         }
     }
 
@@ -367,13 +353,20 @@ namespace slua {
 
     const char* LuaVar::asString(size_t* outlen) const {
         ensure(numOfVar==1 && vars[0].luatype==LV_STRING);
-		if(outlen) *outlen = vars[0].s->length;
-        return vars[0].s->buf;
+		LuaLString lstr = asLString();
+		if(outlen) *outlen = lstr.len;
+        return lstr.buf;
     }
 
 	LuaLString LuaVar::asLString() const
 	{
 		ensure(numOfVar == 1 && vars[0].luatype == LV_STRING);
+		if (vars[0].ref != LUA_NOREF) {
+			// buf points into lua string, it's freed with state
+			if (!stateHandle.get())
+				return { "",0 };
+			return { vars[0].ls.buf,vars[0].ls.length };
+		}
 		return { vars[0].s->buf,vars[0].s->length };
 	}
 
@@ -401,7 +394,7 @@ namespace slua {
             ensure(numOfVar>=index);
             LuaVar r;
             r.alloc(1);
-            r.stateIndex = this->stateIndex;
+            r.stateHandle = this->stateHandle;
             varClone(r.vars[0],vars[index-1]);
             return r;
         }
@@ -459,12 +452,13 @@ namespace slua {
             lua_pushboolean(l,ov.b);
             break;
         case LV_STRING:
-            lua_pushlstring(l,ov.s->buf,ov.s->length);
+            if(ov.ref!=LUA_NOREF) lua_rawgeti(l,LUA_REGISTRYINDEX,ov.ref);
+            else lua_pushlstring(l,ov.s->buf,ov.s->length);
             break;
         case LV_FUNCTION:
         case LV_TABLE:
         case LV_USERDATA:
-            ov.ref->push(l);
+            lua_rawgeti(l,LUA_REGISTRYINDEX,ov.ref);
             break;
         case LV_LIGHTUD:
             lua_pushlightuserdata(l,ov.ptr);
@@ -497,7 +491,7 @@ namespace slua {
     }
 
     bool LuaVar::isValid() const {
-        return stateIndex>0 && LuaState::isValid(stateIndex);
+        return stateHandle.get()!=nullptr;
     }
 
     bool LuaVar::isNil() const {
@@ -566,7 +560,7 @@ namespace slua {
         top=top-argn+1;
         LuaState::pushErrorHandler(L);
         lua_insert(L,top);
-        vars[0].ref->push(L);
+        lua_rawgeti(L,LUA_REGISTRYINDEX,vars[0].ref);
 
 		{
 			LuaScriptCallGuard g(L);
@@ -579,11 +573,66 @@ namespace slua {
         return lua_gettop(L)-top+1;
     }
 
-    int LuaVar::pushArgByParms(UProperty* prop,uint8* parms) {
-        auto L = getState();
-        if (LuaObject::push(L,prop,parms))
-            return prop->ElementSize;
-        return 0;
+    namespace {
+        // flat descriptor of UFunction signature, built on first call and reused
+        struct UFunctionCallPlan {
+            struct Param {
+                UProperty* prop;
+                int32 offset;
+                LuaObject::PushPropertyFunction pusher;
+                LuaObject::CheckPropertyFunction checker;
+            };
+            // arguments pushed to lua
+            TArray<Param> inputs;
+            // return value first, then real out params, filled from lua return values
+            TArray<Param> outputs;
+        };
+
+        // plans are only removed after engine gc when their UFunction is freed,
+        // so a plan stays valid when lua reenters callByUFunction
+        TMap<TWeakObjectPtr<UFunction>, TUniquePtr<UFunctionCallPlan>> callPlans;
+
+        UFunctionCallPlan::Param makeParam(UProperty* prop) {
+            UFunctionCallPlan::Param param;
+            param.prop = prop;
+            param.offset = prop->GetOffset_ForInternal();
+            param.pusher = LuaObject::getPusher(prop);
+            param.checker = LuaObject::getChecker(prop);
+            return param;
+        }
+
+        const UFunctionCallPlan* getCallPlan(UFunction* func) {
+            if (auto plan = callPlans.Find(func))
+                return plan->Get();
+
+            auto plan = new UFunctionCallPlan();
+            if (auto ret = func->GetReturnProperty())
+                plan->outputs.Add(makeParam(ret));
+            for (TFieldIterator<UProperty> it(func); it && (it->PropertyFlags&CPF_Parm); ++it) {
+                UProperty* prop = *it;
+                uint64 propflag = prop->GetPropertyFlags();
+                if (propflag&CPF_ReturnParm)
+                    continue;
+                if (IsRealOutParam(propflag)) {
+                    plan->outputs.Add(makeParam(prop));
+                    continue;
+                }
+                auto param = makeParam(prop);
+                if (!param.pusher) {
+                    FString name = prop->GetClass()->GetName();
+                    Log::Error("unsupport type %s to push", TCHAR_TO_UTF8(*name));
+                }
+                plan->inputs.Add(param);
+            }
+            callPlans.Add(func, TUniquePtr<UFunctionCallPlan>(plan));
+            return plan;
+        }
+    }
+
+    void LuaVar::removeStaleCallPlans() {
+        for (auto it = callPlans.CreateIterator(); it; ++it)
+            if (!it.Key().IsValid())
+                it.RemoveCurrent();
     }
 
     bool LuaVar::callByUFunction(UFunction* func,uint8* parms, LuaVar* pSelf) {
@@ -595,19 +644,8 @@ namespace slua {
             return false;
         }
 
-        const bool bHasReturnParam = func->ReturnValueOffset != MAX_uint16;
-        if(func->ParmsSize==0 && !bHasReturnParam) {
-			int nArg = 0;
-			if (pSelf) {
-				pSelf->push();
-				nArg++;
-			}
-
-			auto L = getState();
-			int n = docall(nArg);
-			lua_pop(L, n);
-            return true;
-        }
+        const UFunctionCallPlan* plan = getCallPlan(func);
+        auto L = getState();
         // push self if valid
         int n=0;
 		if (pSelf) {
@@ -615,43 +653,23 @@ namespace slua {
 			n++;
 		}
         // push arguments to lua state
-        for(TFieldIterator<UProperty> it(func);it && (it->PropertyFlags&CPF_Parm);++it) {
-            UProperty* prop = *it;
-            uint64 propflag = prop->GetPropertyFlags();
-            if((propflag&CPF_ReturnParm) || IsRealOutParam(propflag))
-                continue;
-
-            pushArgByParms(prop,parms+prop->GetOffset_ForInternal());
+        for (const auto& param : plan->inputs) {
+            if (param.pusher)
+                param.pusher(L, param.prop, parms + param.offset);
+            else
+                lua_pushnil(L);
             n++;
         }
         
         int retCount = docall(n);
-		int remain = retCount;
-        auto L = getState();
-        // if lua return value
-        // we only handle first lua return value
-        if(remain >0 && bHasReturnParam) {
-            auto prop = func->GetReturnProperty();
-            auto checkder = prop?LuaObject::getChecker(prop):nullptr;
-            if (checkder) {
-                (*checkder)(L, prop, parms+prop->GetOffset_ForInternal(), lua_absindex(L, -remain));
-            }
-			remain--;
+        // fill lua return values to return value and out params in order,
+        // extra lua return values are ignored
+        int remain = FMath::Min(retCount, plan->outputs.Num());
+        for (int i = 0; i < remain; i++) {
+            const auto& param = plan->outputs[i];
+            if (param.checker)
+                param.checker(L, param.prop, parms + param.offset, lua_absindex(L, -retCount + i));
         }
-
-		// fill lua return value to blueprint stack if argument is out param
-		for (TFieldIterator<UProperty> it(func); remain >0 && it && (it->PropertyFlags&CPF_Parm); ++it) {
-			UProperty* prop = *it;
-			uint64 propflag = prop->GetPropertyFlags();
-			if (IsRealOutParam(propflag))
-			{
-				auto checkder = prop ? LuaObject::getChecker(prop) : nullptr;
-				if (checkder) {
-					(*checkder)(L, prop, parms + prop->GetOffset_ForInternal(), lua_absindex(L, -remain));
-				}
-				remain--;
-			}
-		}
         // pop returned value
         lua_pop(L, retCount);
 		return true;
@@ -659,6 +677,21 @@ namespace slua {
 
     // clone luavar
     void LuaVar::varClone(lua_var& tv,const lua_var& ov) const {
+        tv.ref = LUA_NOREF;
+        // value held by registry ref need a new ref, lua state can only be touched by game thread
+        if(ov.ref!=LUA_NOREF) {
+            check(IsInGameThread());
+            auto L = getState();
+            if(L) {
+                lua_rawgeti(L,LUA_REGISTRYINDEX,ov.ref);
+                tv.ref = luaL_ref(L,LUA_REGISTRYINDEX);
+                if(ov.luatype==LV_STRING) tv.ls = ov.ls;
+                tv.luatype = ov.luatype;
+            }
+            else
+                tv.luatype = LV_NIL;
+            return;
+        }
         switch(ov.luatype) {
         case LV_INT:
             tv.i = ov.i;
@@ -673,12 +706,6 @@ namespace slua {
             tv.s = ov.s;
             tv.s->addRef();
             break;
-        case LV_FUNCTION:
-        case LV_TABLE:
-        case LV_USERDATA:
-            tv.ref = ov.ref;
-            tv.ref->addRef();
-            break;
         case LV_LIGHTUD:
             tv.ptr = ov.ptr;
             break;
@@ -691,10 +718,9 @@ namespace slua {
     }
 
     void LuaVar::clone(const LuaVar& other) {
-        stateIndex = other.stateIndex;
-        numOfVar = other.numOfVar;
-        if(numOfVar>0 && other.vars) {
-            vars = new lua_var[numOfVar];
+        stateHandle = other.stateHandle;
+        if(other.numOfVar>0 && other.vars) {
+            alloc(other.numOfVar);
             for(size_t n=0;n<numOfVar;n++) {
                 varClone( vars[n], other.vars[n] );
             }
@@ -702,9 +728,14 @@ namespace slua {
     }
 
     void LuaVar::move(LuaVar&& other) {
-        stateIndex = other.stateIndex;
+        stateHandle = other.stateHandle;
         numOfVar = other.numOfVar;
-        vars = other.vars;
+        if(other.vars==&other.inlineVar) {
+            inlineVar = other.inlineVar;
+            vars = &inlineVar;
+        }
+        else
+            vars = other.vars;
 
         other.numOfVar = 0;
         other.vars = nullptr;
@@ -84,4 +84,18 @@ namespace slua {
         return p;
 	}
 
+	UProperty* PropertyProto::getProperty(const PropertyProto& proto) {
+		static TMap<TPair<int32, UClass*>, UProperty*> protoCache;
+		auto key = TPair<int32, UClass*>((int32)proto.type, proto.cls);
+		if (auto pp = protoCache.Find(key))
+			return *pp;
+		UProperty* p = createProperty(proto);
+		if (p) {
+			// keep it alive until exit, property class of object property is referenced by it
+			p->AddToRoot();
+			protoCache.Add(key, p);
+		}
+		return p;
+	}
+
 }
\ No newline at end of file
@@ -55,11 +55,7 @@ namespace slua {
         lua_pop(L,1);
     }
 
-    template<typename T>
-    UClass* loadClassT(const char* cls) {
-        TArray<FStringFormatArg> Args;
-        Args.Add(UTF8_TO_TCHAR(cls));
-
+    FString SluaUtil::getClassPath(const char* cls) {
 		FString path(UTF8_TO_TCHAR(cls));
 		int32 index;
 		if (!path.FindChar(TCHAR('\''),index)) {
@@ -73,8 +69,12 @@ namespace slua {
 			path = path.Left(path.Len()-1);
 			path += TEXT("_C'");
 		}
-        
-		UClass* uclass = LoadClass<T>(NULL, *path);
+		return path;
+    }
+
+    template<typename T>
+    UClass* loadClassT(const char* cls) {
+		UClass* uclass = LoadClass<T>(NULL, *SluaUtil::getClassPath(cls));
         return uclass;
     }
 
@@ -112,7 +112,10 @@ namespace slua {
 		UObject* obj = LuaObject::checkValueOpt<UObject*>(L, 2, nullptr);
         auto uclass = loadClassT<UUserWidget>(cls);
         if(uclass==nullptr) luaL_error(L,"Can't find class named %s",cls);
-        
+        return LuaObject::push(L,createWidget(L,uclass,obj));
+    }
+
+    UUserWidget* SluaUtil::createWidget(lua_State* L, UClass* uclass, UObject* obj) {
 		UUserWidget* widget = nullptr;
 		// obj can be 5 type
 		if (obj) {
@@ -147,9 +150,7 @@ namespace slua {
 			if (!GameInstance) luaL_error(L, "gameinstance missing");
 			widget = CreateWidget<UUserWidget>(GameInstance, uclass);
 		}
-
-		
-        return LuaObject::push(L,widget);
+		return widget;
     }
 
     int SluaUtil::createDelegate(lua_State* L) {
@@ -22,6 +22,10 @@ namespace slua {
     public:
         static void openLib(lua_State* L);
         static void reg(lua_State* L,const char* fn,lua_CFunction f);
+        // path of blueprint class with '_C' suffix, cls may be in format of Blueprint'path'
+        static FString getClassPath(const char* cls);
+        // create widget of uclass owned by obj, or by current game instance if obj is nullptr
+        static class UUserWidget* createWidget(lua_State* L, UClass* uclass, UObject* obj);
     private:
         static int loadUI(lua_State* L);
         static int loadClass(lua_State* L);
@@ -29,7 +29,15 @@ protected: \
 	virtual void BeginPlay() override { \
 	if (!init(this, #NAME, LuaStateName, LuaFilePath)) return; \
 		Super::BeginPlay(); \
-		PrimaryActorTick.SetTickFunctionEnable(postInit("bCanEverTick")); \
+		bool tickEnabled = postInit("bCanEverTick"); \
+		initTickLOD(this); \
+		if (tickEnabled && addToTickManager(GetWorld(), PrimaryActorTick.TickGroup)) \
+			tickEnabled = false; \
+		PrimaryActorTick.SetTickFunctionEnable(tickEnabled); \
+	} \
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override { \
+		removeFromTickManager(); \
+		Super::EndPlay(EndPlayReason); \
 	} \
 	virtual void Tick(float DeltaTime) override { \
 		tick(DeltaTime); \
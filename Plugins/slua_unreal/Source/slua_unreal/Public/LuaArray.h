@@ -25,17 +25,27 @@ namespace slua {
     public:
         static void reg(lua_State* L);
         static void clone(FScriptArray* destArray, UProperty* p, const FScriptArray* srcArray);
-		static int push(lua_State* L, UProperty* prop, FScriptArray* array);
+		// if byMove is true, array is a temporary, its storage is moved to the pushed LuaArray
+		static int push(lua_State* L, UProperty* prop, FScriptArray* array, bool byMove = false);
 		static int push(lua_State* L, UArrayProperty* prop, UObject* obj);
 
 		template<typename T>
 		static int push(lua_State* L, const TArray<T>& v) {
-			UProperty* prop = PropertyProto::createProperty(PropertyProto::get<T>());
+			UProperty* prop = PropertyProto::getProperty(PropertyProto::get<T>());
 			auto array = reinterpret_cast<const FScriptArray*>(&v);
 			return push(L, prop, const_cast<FScriptArray*>(array));
 		}
 
-		LuaArray(UProperty* prop, FScriptArray* buf);
+		template<typename T>
+		static int push(lua_State* L, TArray<T>&& v) {
+			UProperty* prop = PropertyProto::getProperty(PropertyProto::get<T>());
+			return push(L, prop, reinterpret_cast<FScriptArray*>(&v), true);
+		}
+
+		// append elements of lua table at p to array, table index begin from 1
+		static void fillFromTable(lua_State* L, int p, UProperty* inner, FScriptArray* array);
+
+		LuaArray(UProperty* prop, FScriptArray* buf, bool byMove = false);
 		LuaArray(UArrayProperty* prop, UObject* obj);
         ~LuaArray();
 
@@ -43,6 +53,9 @@ namespace slua {
             return array;
         }
 
+        // move storage to dest if marked by arr:Move(), otherwise copy elements to dest
+        void moveOrClone(UProperty* destInner, FScriptArray* dest);
+
         // Cast FScriptArray to TArray<T> if ElementSize matched
         template<typename T>
         const TArray<T>& asTArray(lua_State* L) const {
@@ -62,6 +75,8 @@ namespace slua {
         
     protected:
         static int __ctor(lua_State* L);
+        static int FromTable(lua_State* L);
+        static int ToTable(lua_State* L);
         static int Num(lua_State* L);
         static int Get(lua_State* L);
 		static int Set(lua_State* L);
@@ -69,14 +84,19 @@ namespace slua {
         static int Remove(lua_State* L);
         static int Insert(lua_State* L);
         static int Clear(lua_State* L);
+        static int Move(lua_State* L);
 		static int Pairs(lua_State* L);
 		static int Enumerable(lua_State* L);
+		static int __index(lua_State* L);
+		static int __newindex(lua_State* L);
+		static int __len(lua_State* L);
 
     private:
         UProperty* inner;
         FScriptArray* array;
 		UArrayProperty* prop;
 		UObject* propObj;
+		bool movable;
 
         void clear();
         uint8* getRawPtr(int index) const;
@@ -90,12 +110,5 @@ namespace slua {
 
         static int setupMT(lua_State* L);
         static int gc(lua_State* L);
-
-		struct Enumerator {
-			LuaArray* arr;
-			int32 index;
-
-			static int gc(lua_State* L);
-		};
     };
 }
\ No newline at end of file
@@ -0,0 +1,37 @@
+// Tencent is pleased to support the open source community by making sluaunreal available.
+
+// Copyright (C) 2018 THL A29 Limited, a Tencent company. All rights reserved.
+// Licensed under the BSD 3-Clause License (the "License");
+// you may not use this file except in compliance with the License. You may obtain a copy of the License at
+
+// https://opensource.org/licenses/BSD-3-Clause
+
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and limitations under the License.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "lua/lua.hpp"
+
+struct FStreamableManager;
+
+namespace slua {
+
+	// async version of slua.loadObject, slua.loadClass and slua.loadUI:
+	//   slua.loadObjectAsync(path or paths[, callback[, priority]])
+	//   slua.loadClassAsync(path or paths[, callback[, priority]])
+	//   slua.loadUIAsync(path or paths[, owner[, callback[, priority]]])
+	// all paths are loaded in one request, callback receive loaded objects in order of paths,
+	// return a handle can be cancelled by handle:Cancel().
+	// without callback, running coroutine wait for loading and get loaded objects as results.
+	// paths already loaded are resolved immediately without waiting
+	class SLUA_UNREAL_API LuaAsyncLoader {
+	public:
+		static void reg(lua_State* L);
+		// streamable manager of asset manager if configured, or a shared one
+		static FStreamableManager& getStreamableManager();
+	};
+}
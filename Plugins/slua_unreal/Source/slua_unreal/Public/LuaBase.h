@@ -15,16 +15,67 @@
 #include "CoreMinimal.h"
 #include "LuaState.h"
 #include "LuaBlueprintLibrary.h"
+#include "Engine/EngineBaseTypes.h"
+
+class UWorld;
+class AActor;
 
 namespace slua {
 
+	class LuaTickManager;
+
 // special tick function
 #define UFUNCTION_TICK ((UFunction*)-1)
+// lightuserdata of LuaBase in luaSelfTable, used to update overrides
+#define SLUA_LUABASE "__luabase"
+
+	// lua function found in class table for a blueprint event
+	struct LuaEventOverride {
+		// name of event as lua string, converted once
+		LuaVar name;
+		// nil if class table doesn't implement event
+		LuaVar func;
+	};
+
+	// every blueprint event of a class, events not in map aren't blueprint event
+	typedef TMap<UFunction*, LuaEventOverride> LuaOverrideMap;
+
+	// lua class loaded from LuaFilePath, shared by all instances in same state
+	struct LuaClassModule {
+		LuaVar classTable;
+		// metatable of instance self table for each UClass,
+		// __index search class table then cpp instance with per key forwarding cache
+		TMap<TWeakObjectPtr<UClass>, LuaVar> metaTables;
+		TMap<TWeakObjectPtr<UClass>, TSharedPtr<LuaOverrideMap>> overrides;
+	};
+
+	// tick rate LOD, significance in [0,1] select a bucket ticking every 1/2/4/10 frames,
+	// delta time of skipped frames is accumulated and passed to lua
+	struct LuaTickLOD {
+		static const int BucketCount = 4;
+		// frame interval of each bucket
+		static const int FrameDivisor[BucketCount];
+		// bucket i is used if significance >= MinSignificance[i]
+		static const float MinSignificance[BucketCount];
+
+		static int bucketOf(float significance);
+
+		bool enabled = false;
+		int bucket = 0;
+		int frame = 0;
+		float accum = 0;
+		// significance reaches 0 at this distance to nearest viewer
+		float distance = 0;
+		// optional lua function(self) return significance, override distance
+		LuaVar significanceFunc;
+	};
 
 	class SLUA_UNREAL_API LuaBase {
 	public:
 		virtual bool luaImplemented(UFunction* func, void* params);
-		virtual ~LuaBase() {}
+		virtual ~LuaBase();
+		// free class modules of ls, called before ls closed
+		static void removeClassModules(LuaState* ls);
 	protected:
 		template<typename T>
 		static int super(lua_State* L) {
@@ -58,35 +109,38 @@ namespace slua {
 			if (stateName.Len() != 0) ls = LuaState::get(stateName);
 			if (!ls) return false;
 
-			luaSelfTable = ls->doFile(TCHAR_TO_UTF8(*luaPath));
-			if (!luaSelfTable.isTable())
+			// class module is compiled once per state and path,
+			// each instance only creates a self table chained to it
+			LuaClassModule* module = loadClassModule(ls, luaPath);
+			if (!module)
 				return false;
+			luaClassTable = module->classTable;
 
 			auto L = ls->getLuaState();
-			// setup __cppinst
-			luaSelfTable.push(L);
+			lua_newtable(L);
+			luaSelfTable.set(L, -1);
 
+			// setup __cppinst
 			LuaObject::push(L, ptrT);
 			lua_setfield(L, -2, SLUA_CPPINST);
 
 			lua_pushcfunction(L, &LuaBase::super<T>);
 			lua_setfield(L, -2, "Super");
 
-			// setup metatable
-			if (!metaTable.isValid()) {
-				luaL_newmetatable(L, typeName);
-				lua_pushcfunction(L, __index);
-				lua_setfield(L, -2, "__index");
-				lua_pushcfunction(L, __newindex);
-				lua_setfield(L, -2, "__newindex");
-				metaTable.set(L, -1);
-				lua_pop(L, 1);
-			}
-			metaTable.push(L);
+			lua_pushlightuserdata(L, this);
+			lua_setfield(L, -2, SLUA_LUABASE);
+
+			overrideClass = ptrT->GetClass();
+			pushInstanceMT(L, module, overrideClass);
 			lua_setmetatable(L, -2);
 
 			// pop luaSelfTable
 			lua_pop(L, 1);
+
+			auto& classOverrides = module->overrides.FindOrAdd(overrideClass);
+			if (!classOverrides.IsValid())
+				classOverrides = collectOverrides(overrideClass, luaClassTable);
+			overrides = classOverrides;
 			return true;
 		}
 
@@ -101,15 +155,46 @@ namespace slua {
 		LuaVar callMember(FString name, const TArray<FLuaBPVar>& args);
 
 		bool postInit(const char* tickFlag,bool rawget=true);
+		// if lua table set bBatchTick, tick by LuaTickManager instead of engine tick function,
+		// return true if added to tick manager
+		bool addToTickManager(UWorld* world, ETickingGroup group);
+		void removeFromTickManager();
+		// enable tick LOD if lua table set TickLODDistance or GetTickSignificance,
+		// actor is used to get distance to viewers, may be nullptr
+		void initTickLOD(AActor* actor);
+		// accumulate DeltaTime, return true with accumulated time if tick this frame
+		bool stepTickLOD(float DeltaTime, float& outDeltaTime);
+		float tickSignificance();
 		void tick(float DeltaTime);
 		// should override this function to support super::tick
 		virtual void superTick() = 0;
 		static int __index(lua_State* L);
 		static int __newindex(lua_State* L);
 
+		// load class module of luaPath or return cached one, return nullptr if failed
+		static LuaClassModule* loadClassModule(LuaState* ls, const FString& luaPath);
+		// push metatable of instance self table for cls
+		static void pushInstanceMT(lua_State* L, LuaClassModule* module, UClass* cls);
+		// collect blueprint events of cls and lua functions implement them in class table
+		static TSharedPtr<LuaOverrideMap> collectOverrides(UClass* cls, const LuaVar& classTable);
+		// push field of self table, if rawget, skip cpp instance and only search self table and class table
+		void pushMember(lua_State* L, const char* name, bool rawget);
+
 		LuaVar luaSelfTable;
+		LuaVar luaClassTable;
 		LuaVar tickFunction;
-		static LuaVar metaTable;
+
+		UClass* overrideClass = nullptr;
+		// shared by instances of same class, function of entry is updated when class table changed
+		TSharedPtr<LuaOverrideMap> overrides;
+		// blueprint events implemented by functions set to self table
+		TMap<UFunction*, LuaVar> selfOverrides;
+
+		LuaTickManager* tickManager = nullptr;
+		friend class LuaTickManager;
+
+		LuaTickLOD tickLOD;
+		AActor* lodActor = nullptr;
 
 		friend struct UFunctionParamScope;
 	};
@@ -0,0 +1,42 @@
+// Tencent is pleased to support the open source community by making sluaunreal available.
+
+// Copyright (C) 2018 THL A29 Limited, a Tencent company. All rights reserved.
+// Licensed under the BSD 3-Clause License (the "License");
+// you may not use this file except in compliance with the License. You may obtain a copy of the License at
+
+// https://opensource.org/licenses/BSD-3-Clause
+
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and limitations under the License.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "lua/lua.hpp"
+
+namespace slua {
+
+	// bytecode of lua source cached on disk, file named by hash of chunk name, source and vm build id,
+	// so changed source or vm never hit stale bytecode.
+	// bytecode shipped in Content/LuaBytecode by LuaPrecompile commandlet is searched first,
+	// then Saved/LuaBytecode, which is written when source compiled at runtime
+	class SLUA_UNREAL_API LuaBytecodeCache {
+	public:
+		// same as luaL_loadbuffer, but load cached bytecode of source if exists,
+		// and cache bytecode of source after compiled if writeCache
+		static int load(lua_State* L, const uint8* buf, uint32 len, const char* chunk, bool writeCache = true);
+		// compile all lua files under srcDir and save bytecode to dstDir,
+		// return number of compiled files, failed is number of files can't be read, compiled or saved
+		static int32 precompile(const FString& srcDir, const FString& dstDir, int32& failed);
+
+		static FString getShippedDir();
+		static FString getSavedDir();
+		// chunk name of lua file, relative to Content dir if under it,
+		// so it's same on cook machine and device
+		static FString getChunkName(const FString& filepath);
+		// cache file name of source loaded as chunk
+		static FString getKey(const uint8* buf, uint32 len, const char* chunk);
+	};
+}
@@ -0,0 +1,113 @@
+// Tencent is pleased to support the open source community by making sluaunreal available.
+
+// Copyright (C) 2018 THL A29 Limited, a Tencent company. All rights reserved.
+// Licensed under the BSD 3-Clause License (the "License");
+// you may not use this file except in compliance with the License. You may obtain a copy of the License at
+
+// https://opensource.org/licenses/BSD-3-Clause
+
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and limitations under the License.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "UObject/Object.h"
+#include "Engine/LatentActionManager.h"
+#include "lua/lua.hpp"
+#include "LuaCoroutine.generated.h"
+
+namespace slua {
+	class LuaCoroutineScheduler;
+}
+
+// callback target of latent action awaited by lua coroutine
+UCLASS()
+class SLUA_UNREAL_API ULuaLatentCallback : public UObject {
+	GENERATED_BODY()
+public:
+	UFUNCTION()
+	void OnLatentComplete(int32 Linkage);
+
+	slua::LuaCoroutineScheduler* scheduler = nullptr;
+};
+
+namespace slua {
+
+	// resume lua coroutines waiting for time, frames, delegates or latent actions,
+	// waiting coroutines cost nothing until resumed, except waitUntil with a predicate function
+	class SLUA_UNREAL_API LuaCoroutineScheduler {
+	public:
+		LuaCoroutineScheduler(lua_State* L);
+		~LuaCoroutineScheduler();
+
+		// register slua.wait, slua.waitFrames and slua.waitUntil
+		static void reg(lua_State* L);
+		static LuaCoroutineScheduler* get(lua_State* L);
+
+		void tick(float dtime);
+
+		// fill info to resume running coroutine of L when latent action completed
+		void awaitLatent(lua_State* L, FLatentActionInfo& info);
+		// call after latent function called with info filled by awaitLatent,
+		// if no action registered, forget waiting coroutine and return false, it shouldn't yield
+		bool checkLatentStarted(int32 uuid);
+		void onLatentComplete(int32 linkage);
+
+		// ref running coroutine of L to be resumed by wake, raise error if it can't yield,
+		// caller should yield L after suspend
+		int suspend(lua_State* L, const char* fn);
+		// resume coroutine returned by suspend in next tick
+		void wake(int threadRef);
+
+	protected:
+		static int wait(lua_State* L);
+		static int waitFrames(lua_State* L);
+		static int waitUntil(lua_State* L);
+		static int onDelegateFired(lua_State* L);
+
+	private:
+		struct TimeWaiter {
+			int threadRef;
+			double wakeTime;
+			bool operator<(const TimeWaiter& other) const { return wakeTime < other.wakeTime; }
+		};
+		struct FrameWaiter {
+			int threadRef;
+			uint64 wakeFrame;
+			bool operator<(const FrameWaiter& other) const { return wakeFrame < other.wakeFrame; }
+		};
+		struct DelegateWaiter {
+			int threadRef;
+			int delegateRef;
+			// handle returned by delegate:Add, used to remove listener
+			void* handle;
+		};
+		struct PredicateWaiter {
+			int threadRef;
+			int funcRef;
+		};
+
+		lua_State* L;
+		double time;
+		uint64 frame;
+		int32 latentUUID;
+		ULuaLatentCallback* latentCallback;
+
+		// min heaps ordered by wake time and wake frame
+		TArray<TimeWaiter> timeQueue;
+		TArray<FrameWaiter> frameQueue;
+		// keyed by waiting thread
+		TMap<lua_State*, DelegateWaiter> delegateWaiters;
+		TArray<lua_State*> firedDelegates;
+		TArray<PredicateWaiter> predicateWaiters;
+		// latent action uuid to thread ref
+		TMap<int32, int> latentWaiters;
+		// woken by completed latent actions or wake
+		TArray<int> readyThreads;
+
+		void resume(int threadRef);
+	};
+}
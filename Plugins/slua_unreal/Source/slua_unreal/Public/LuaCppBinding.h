@@ -95,6 +95,11 @@ namespace slua {
 			return LuaObject::checkTMap<T>(L, p);
 		}
 
+		template <typename T>
+		static typename std::enable_if<TIsTSet<T>::Value, T>::type readArg(lua_State * L, int p) {
+			return LuaObject::checkTSet<T>(L, p);
+		}
+
 		template <typename T>
 		static typename std::enable_if<std::is_enum<T>::value, T>::type readArg(lua_State * L, int p) {
 			return LuaObject::checkEnumValue<T>(L, p);
@@ -109,7 +114,7 @@ namespace slua {
 		}
 
 		template <typename T>
-		static typename std::enable_if<!TIsTArray<T>::Value && !TIsTMap<T>::Value && !TIsTFunction<T>::Value && !std::is_enum<T>::value, T>::type readArg(lua_State * L, int p) {
+		static typename std::enable_if<!TIsTArray<T>::Value && !TIsTMap<T>::Value && !TIsTSet<T>::Value && !TIsTFunction<T>::Value && !std::is_enum<T>::value, T>::type readArg(lua_State * L, int p) {
 			return LuaObject::checkValue<T>(L, p);
 		}
 
@@ -119,18 +124,25 @@ namespace slua {
 
 		template <typename T>
 		static typename std::enable_if<TIsTArray<T>::Value, T>::type readArg(lua_State * L, int p) {
-			if (!lua_isuserdata(L, p))
+			if (!lua_isuserdata(L, p) && !lua_istable(L, p))
 				return T();
 			return LuaObject::checkTArray<T>(L, p);
 		}
 
 		template <typename T>
 		static typename std::enable_if<TIsTMap<T>::Value, T>::type readArg(lua_State * L, int p) {
-			if (!lua_isuserdata(L, p))
+			if (!lua_isuserdata(L, p) && !lua_istable(L, p))
 				return T();
 			return LuaObject::checkTMap<T>(L, p);
 		}
 
+		template <typename T>
+		static typename std::enable_if<TIsTSet<T>::Value, T>::type readArg(lua_State * L, int p) {
+			if (!lua_isuserdata(L, p) && !lua_istable(L, p))
+				return T();
+			return LuaObject::checkTSet<T>(L, p);
+		}
+
 		template <typename T>
 		static typename std::enable_if<std::is_enum<T>::value, T>::type readArg(lua_State * L, int p) {
 			if (!lua_isinteger(L, p))
@@ -149,7 +161,7 @@ namespace slua {
 		}
 
 		template <typename T>
-		static typename std::enable_if<!TIsTArray<T>::Value && !TIsTMap<T>::Value && !TIsTFunction<T>::Value && !std::is_enum<T>::value, T>::type readArg(lua_State * L, int p) {
+		static typename std::enable_if<!TIsTArray<T>::Value && !TIsTMap<T>::Value && !TIsTSet<T>::Value && !TIsTFunction<T>::Value && !std::is_enum<T>::value, T>::type readArg(lua_State * L, int p) {
 			return LuaObject::checkValueOpt<T>(L, p);
 		}
 
@@ -196,13 +208,26 @@ namespace slua {
             }
         };
 
+        // container returned by value is a temporary, move it to lua
+        template<typename VT>
+        static typename std::enable_if<!std::is_reference<VT>::value && !std::is_const<VT>::value 
+            && (TIsTArray<VT>::Value || TIsTMap<VT>::Value || TIsTSet<VT>::Value), int>::type pushReturn(lua_State* L, VT& ret) {
+            return LuaObject::push(L, MoveTemp(ret));
+        }
+
+        template<typename VT>
+        static typename std::enable_if<std::is_reference<VT>::value || std::is_const<VT>::value 
+            || !(TIsTArray<VT>::Value || TIsTMap<VT>::Value || TIsTSet<VT>::Value), int>::type pushReturn(lua_State* L, VT& ret) {
+            return LuaObject::push(L, ret);
+        }
+
         static int invoke(lua_State * L,void* ptr) {
             // make int list for arg index
             using I = MakeIntList<sizeof...(Args)>;
             T ret = Functor<I>::invoke(L,ptr);
             void* v = ReturnPointer<T>::GetValue(ret);
             if(v==nullptr) return LuaObject::pushNil(L);
-            return LuaObject::push(L,ret);
+            return pushReturn<T>(L,ret);
         }
     };
 
@@ -328,6 +353,8 @@ namespace slua {
 
     struct SLUA_UNREAL_API LuaClass {
         LuaClass(lua_CFunction reg);
+        // setup of type name run in each state when name first used, see LuaObject::addLazyType
+        LuaClass(const char* name, lua_CFunction reg);
         static void reg(lua_State* L);
     };
 
@@ -392,7 +419,7 @@ namespace slua {
             return 1; \
         } \
         static int Lua##CLS##_setup(lua_State* L); \
-        static LuaClass Lua##CLS##__(Lua##CLS##_setup); \
+        static LuaClass Lua##CLS##__(#CLS, Lua##CLS##_setup); \
         int Lua##CLS##_setup(lua_State* L) { \
 			static_assert(!std::is_base_of<UObject, CLS>::value, "UObject class shouldn't use LuaCppBinding. Use REG_EXTENSION instead."); \
             AutoStack autoStack(L); \
@@ -468,14 +495,14 @@ namespace slua {
 			LuaObject::newEnum(L, #NAME, #__VA_ARGS__, std::initializer_list<int>{(int)__VA_ARGS__}); \
 			return 0;\
 		} \
-		static LuaClass LuaEnum##NAME##__(LuaEnum##NAME##_setup); \
+		static LuaClass LuaEnum##NAME##__(#NAME, LuaEnum##NAME##_setup); \
 
 	#define DefEnumClass(NAME,...) \
 		static int LuaEnum##NAME##_setup(lua_State* L) { \
 			LuaObject::newEnum(L, #NAME, #__VA_ARGS__, std::initializer_list<NAME>{__VA_ARGS__}); \
 			return 0;\
 		} \
-		static LuaClass LuaEnum##NAME##__(LuaEnum##NAME##_setup); \
+		static LuaClass LuaEnum##NAME##__(#NAME, LuaEnum##NAME##_setup); \
 
     #define REG_EXTENSION_METHOD(U,N,M) { \
 		using BindType = LuaCppBinding<decltype(M),M>; \
@@ -15,6 +15,7 @@
 
 #include "CoreMinimal.h"
 #include "lua/lua.hpp"
+#include "LuaFunction.h"
 #include "LuaDelegate.generated.h"
 
 namespace slua {
@@ -125,12 +126,11 @@ namespace slua {
 		static int BindT(lua_State* L) {
 			LuaDelegateWrapT<R, ARGS...>* ud = LuaObject::checkUD<LuaDelegateWrapT<R, ARGS...>>(L,1);
 			luaL_checktype(L, 2, LUA_TFUNCTION);
-			LuaVar func(L, 2);
-			if (func.isValid() && func.isFunction())
+			LuaFunction<R(ARGS...)> func(L, 2);
+			if (func.isValid())
 			{
 				ud->delegate.BindLambda([=](ARGS ...args) {
-					LuaVar result = func.call(std::forward<ARGS>(args) ...);
-					return result.castTo<R>();
+					return func.call(args...);
 				});
 			}
 			return 0;
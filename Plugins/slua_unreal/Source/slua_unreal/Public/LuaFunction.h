@@ -0,0 +1,167 @@
+// Tencent is pleased to support the open source community by making sluaunreal available.
+
+// Copyright (C) 2018 THL A29 Limited, a Tencent company. All rights reserved.
+// Licensed under the BSD 3-Clause License (the "License");
+// you may not use this file except in compliance with the License. You may obtain a copy of the License at
+
+// https://opensource.org/licenses/BSD-3-Clause
+
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and limitations under the License.
+
+#pragma once
+#include "CoreMinimal.h"
+#include "LuaState.h"
+#include <utility>
+#include <type_traits>
+
+namespace slua {
+
+	template<typename R>
+	struct LuaFunctionResult {
+		enum { Count = 1 };
+		static R read(lua_State* L, int p) {
+			return ArgOperatorOpt::readArg<typename remove_cr<R>::type>(L, p);
+		}
+		static R failed() {
+			return typename remove_cr<R>::type();
+		}
+	};
+
+	template<>
+	struct LuaFunctionResult<void> {
+		enum { Count = 0 };
+		static void read(lua_State* L, int p) {}
+		static void failed() {}
+	};
+
+	template<typename T>
+	class LuaFunction;
+
+	// typed handle of lua function, function is held by registry ref,
+	// arguments pushed and result read by static type, no LuaVar created for each call
+	template<typename R, typename ...ARGS>
+	class LuaFunction<R(ARGS...)> {
+	public:
+		LuaFunction() :ref(LUA_NOREF) {}
+
+		LuaFunction(lua_State* L, int p) :ref(LUA_NOREF) {
+			set(L, p);
+		}
+
+		LuaFunction(const LuaFunction& other) :ref(LUA_NOREF) {
+			clone(other);
+		}
+
+		LuaFunction(LuaFunction&& other) :stateHandle(other.stateHandle), ref(other.ref) {
+			other.ref = LUA_NOREF;
+		}
+
+		~LuaFunction() {
+			free();
+		}
+
+		LuaFunction& operator=(const LuaFunction& other) {
+			if (this != &other) {
+				free();
+				clone(other);
+			}
+			return *this;
+		}
+
+		LuaFunction& operator=(LuaFunction&& other) {
+			if (this != &other) {
+				free();
+				stateHandle = other.stateHandle;
+				ref = other.ref;
+				other.ref = LUA_NOREF;
+			}
+			return *this;
+		}
+
+		// ref function at p, return false if it isn't a function
+		bool set(lua_State* L, int p) {
+			free();
+			if (lua_type(L, p) != LUA_TFUNCTION)
+				return false;
+			stateHandle = LuaState::get(L)->handle();
+			lua_pushvalue(L, p);
+			ref = luaL_ref(L, LUA_REGISTRYINDEX);
+			return true;
+		}
+
+		// return true if function is referenced and its state still alive
+		bool isValid() const {
+			return ref != LUA_NOREF && stateHandle.get() != nullptr;
+		}
+
+		// call lua function with typed arguments,
+		// return default value of R if function is invalid or raised an error
+		template<typename ...TS>
+		R call(TS&& ...args) const {
+			LuaState* ls = stateHandle.get();
+			if (!ls || ref == LUA_NOREF) {
+				Log::Error("State of lua function is invalid");
+				return LuaFunctionResult<R>::failed();
+			}
+			lua_State* L = ls->getLuaState();
+			int top = lua_gettop(L);
+			int errfunc = LuaState::pushErrorHandler(L);
+			lua_rawgeti(L, LUA_REGISTRYINDEX, ref);
+			int n = pushArg(L, args...);
+			{
+				LuaScriptCallGuard g(L);
+				if (lua_pcall(L, n, LuaFunctionResult<R>::Count, errfunc)) {
+					lua_settop(L, top);
+					return LuaFunctionResult<R>::failed();
+				}
+			}
+			// restore stack top before return value read out
+			struct StackRestore {
+				lua_State* L; int top;
+				~StackRestore() { lua_settop(L, top); }
+			} restore = { L, top };
+			return LuaFunctionResult<R>::read(L, -1);
+		}
+
+		template<typename ...TS>
+		R operator()(TS&& ...args) const {
+			return call(std::forward<TS>(args)...);
+		}
+
+	private:
+		LuaStateHandle stateHandle;
+		int ref;
+
+		template<typename F, typename ...TS>
+		static int pushArg(lua_State* L, F& f, TS& ...args) {
+			LuaObject::push(L, f);
+			return 1 + pushArg(L, args...);
+		}
+
+		static int pushArg(lua_State* L) {
+			return 0;
+		}
+
+		void clone(const LuaFunction& other) {
+			LuaState* ls = other.stateHandle.get();
+			if (!ls || other.ref == LUA_NOREF)
+				return;
+			// copy ref function by lua state, only game thread can touch it
+			check(IsInGameThread());
+			lua_State* L = ls->getLuaState();
+			lua_rawgeti(L, LUA_REGISTRYINDEX, other.ref);
+			stateHandle = other.stateHandle;
+			ref = luaL_ref(L, LUA_REGISTRYINDEX);
+		}
+
+		void free() {
+			LuaState* ls = stateHandle.get();
+			if (ls && ref != LUA_NOREF)
+				luaL_unref(ls->getLuaState(), LUA_REGISTRYINDEX, ref);
+			ref = LUA_NOREF;
+		}
+	};
+}
@@ -46,18 +46,28 @@ namespace slua {
 
 	public:
 		static void reg(lua_State* L);
-		static int push(lua_State* L, UProperty* keyProp, UProperty* valueProp, const FScriptMap* buf, bool frombp=true);
+		// if byMove is true, buf is a temporary, its storage is moved to the pushed LuaMap
+		static int push(lua_State* L, UProperty* keyProp, UProperty* valueProp, const FScriptMap* buf, bool frombp=true, bool byMove=false);
 		static int push(lua_State* L, UMapProperty* prop, UObject* obj);
 		template<typename K,typename V>
 		static int push(lua_State* L, const TMap<K, V>& v) {
-			UProperty* keyProp = PropertyProto::createProperty(PropertyProto::get<K>());
-			UProperty* valueProp = PropertyProto::createProperty(PropertyProto::get<V>());
+			UProperty* keyProp = PropertyProto::getProperty(PropertyProto::get<K>());
+			UProperty* valueProp = PropertyProto::getProperty(PropertyProto::get<V>());
 			return push(L, keyProp, valueProp, reinterpret_cast<const FScriptMap*>(&v),false);
 		}
 
+		template<typename K,typename V>
+		static int push(lua_State* L, TMap<K, V>&& v) {
+			UProperty* keyProp = PropertyProto::getProperty(PropertyProto::get<K>());
+			UProperty* valueProp = PropertyProto::getProperty(PropertyProto::get<V>());
+			return push(L, keyProp, valueProp, reinterpret_cast<const FScriptMap*>(&v),false,true);
+		}
+
 		static void clone(FScriptMap* dest,UProperty* keyProp, UProperty* valueProp,const FScriptMap* src);
+		// add pairs of lua table at p to map by helper
+		static void fillFromTable(lua_State* L, int p, UProperty* keyProp, UProperty* valueProp, FScriptMapHelper& helper);
 
-		LuaMap(UProperty* keyProp, UProperty* valueProp, const FScriptMap* buf, bool frombp);
+		LuaMap(UProperty* keyProp, UProperty* valueProp, const FScriptMap* buf, bool frombp, bool byMove = false);
 		LuaMap(UMapProperty* prop, UObject* obj);
 		~LuaMap();
 
@@ -65,6 +75,9 @@ namespace slua {
 			return map;
 		}
 
+		// move storage to dest if marked by map:Move(), otherwise copy pairs to dest
+		void moveOrClone(UProperty* destKeyProp, UProperty* destValueProp, FScriptMap* dest);
+
 		virtual void AddReferencedObjects( FReferenceCollector& Collector ) override;
 
 #if (ENGINE_MINOR_VERSION>=20) && (ENGINE_MAJOR_VERSION>=4)
@@ -101,13 +114,20 @@ namespace slua {
 
 	protected:
 		static int __ctor(lua_State* L);
+		static int FromTable(lua_State* L);
+		static int ToTable(lua_State* L);
         static int Num(lua_State* L);
         static int Get(lua_State* L);
         static int Add(lua_State* L);
         static int Remove(lua_State* L);
         static int Clear(lua_State* L);
+		static int Move(lua_State* L);
+		static int Contains(lua_State* L);
+		static int Keys(lua_State* L);
+		static int Values(lua_State* L);
 		static int Pairs(lua_State* L);
-		static int Enumerable(lua_State* L);
+		static int EnumerableByIndex(lua_State* L);
+		static int __len(lua_State* L);
 
 	private:
 		FScriptMap* map;
@@ -117,6 +137,7 @@ namespace slua {
 		UObject* propObj;
 		FScriptMapHelper helper;
 		bool createdByBp;
+		bool movable;
 
 		static int setupMT(lua_State* L);
 		static int gc(lua_State* L);
@@ -128,16 +149,10 @@ namespace slua {
 		void emptyValues(int32 Slack = 0);
 		void destructItems(int32 Index, int32 Count);
 		void destructItems(uint8* PairPtr, uint32 Stride, int32 Index, int32 Count, bool bDestroyKeys, bool bDestroyValues);
-		bool removePair(const void* KeyPtr);
+		uint8* findValue(lua_State* L, int p);
+		int32 indexOfValue(uint8* valuePtr);
 		void removeAt(int32 Index, int32 Count = 1);
-
-		struct Enumerator {
-			LuaMap* map;
-			int32 index;
-			int32 num;
-
-			static int gc(lua_State* L);
-		};
+		int pushPairFrom(lua_State* L, int32 index);
 
 	};
 	
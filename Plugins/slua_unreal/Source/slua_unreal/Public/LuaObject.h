@@ -21,6 +21,7 @@
 #include "SluaUtil.h"
 #include "LuaArray.h"
 #include "LuaMap.h"
+#include "LuaSet.h"
 #include "Runtime/Launch/Resources/Version.h"
 
 #ifndef SLUA_CPPINST
@@ -39,10 +40,12 @@
 
 #define RegMetaMethod(L,METHOD) RegMetaMethodByName(L,#METHOD,METHOD)
 
+#define InitUDLink(ptr) ptr->parent = ptr->children = ptr->prev = ptr->next = nullptr
+
 #define NewUD(T, v, f) auto ud = lua_newuserdata(L, sizeof(UserData<T*>)); \
 	if (!ud) luaL_error(L, "out of memory to new ud"); \
 	auto udptr = reinterpret_cast< UserData<T*>* >(ud); \
-	udptr->parent = nullptr; \
+	InitUDLink(udptr); \
 	udptr->ud = const_cast<T*>(v); \
     udptr->flag = f;
 
@@ -98,10 +101,15 @@ namespace slua {
 	#define UD_UOBJECT 1<<5 // flag it's an UObject
 
 	// Memory layout of GenericUserData and UserData should be same
+	// parent/children/prev/next make an intrusive list of property userdata
+	// linked to its owner userdata, see LuaObject::linkProp
 	struct GenericUserData {
 		void* ud;
 		uint32 flag;
 		void* parent;
+		void* children;
+		void* prev;
+		void* next;
 	};
 
 	template<class T>
@@ -109,11 +117,15 @@ namespace slua {
 		T ud; 
 		uint32 flag; 
 		void* parent; 
+		void* children;
+		void* prev;
+		void* next;
 		static_assert(sizeof(T)==sizeof(void*),"Userdata type should size equal to sizeof(void*)"); 
 	};
 
     DefTypeName(LuaArray);
     DefTypeName(LuaMap);
+    DefTypeName(LuaSet);
 
     template<typename T>
     struct LuaOwnedPtr {
@@ -249,6 +261,14 @@ namespace slua {
 		}
         static void init(lua_State* L);
 
+		// setup of type named tn run in each state when tn first used,
+		// by global lookup, push or check of userdata of the type
+		static void addLazyType(const char* tn, TFunction<void(lua_State*)> setup);
+		// run setup of lazy type tn if not setup in L yet, return false if tn isn't pending lazy type
+		static bool setupLazyType(lua_State* L, const char* tn);
+		// same as luaL_getmetatable, but setup lazy type tn if its metatable not created
+		static int pushMetatable(lua_State* L, const char* tn);
+
 
         
 
@@ -348,6 +368,19 @@ namespace slua {
         // check value if it's TArray
         template<class T>
 		static T checkTArray(lua_State* L, int p) {
+            // accept plain lua table
+            if (lua_istable(L, p)) {
+                p = lua_absindex(L, p);
+                T ret;
+                int n = (int)lua_rawlen(L, p);
+                ret.Reserve(n);
+                for (int i = 1; i <= n; i++) {
+                    lua_rawgeti(L, p, i);
+                    ret.Add(checkValue<typename T::ElementType>(L, -1));
+                    lua_pop(L, 1);
+                }
+                return ret;
+            }
             CheckUD(LuaArray,L,p);
 			return UD->asTArray<typename T::ElementType>(L);
 		}
@@ -355,12 +388,45 @@ namespace slua {
 		// check value if it's TMap
 		template<class T>
 		static T checkTMap(lua_State* L, int p) {
-			CheckUD(LuaMap, L, p);
 			using KeyType = typename TPairTraits<typename T::ElementType>::KeyType;
 			using ValueType = typename TPairTraits<typename T::ElementType>::ValueType;
+			// accept plain lua table
+			if (lua_istable(L, p)) {
+				p = lua_absindex(L, p);
+				T ret;
+				lua_pushnil(L);
+				while (lua_next(L, p)) {
+					// check copy of key, checkValue may convert key in place and break lua_next
+					lua_pushvalue(L, -2);
+					ret.Add(checkValue<KeyType>(L, -1), checkValue<ValueType>(L, -2));
+					lua_pop(L, 2);
+				}
+				return ret;
+			}
+			CheckUD(LuaMap, L, p);
 			return UD->asTMap<KeyType, ValueType>(L);
 		}
 
+		// check value if it's TSet
+		template<class T>
+		static T checkTSet(lua_State* L, int p) {
+			// accept plain lua table
+			if (lua_istable(L, p)) {
+				p = lua_absindex(L, p);
+				T ret;
+				int n = (int)lua_rawlen(L, p);
+				ret.Reserve(n);
+				for (int i = 1; i <= n; i++) {
+					lua_rawgeti(L, p, i);
+					ret.Add(checkValue<typename T::ElementType>(L, -1));
+					lua_pop(L, 1);
+				}
+				return ret;
+			}
+			CheckUD(LuaSet, L, p);
+			return UD->asTSet<typename T::ElementType>(L);
+		}
+
         template<class T>
         static UObject* checkUObject(lua_State* L,int p) {
             UserData<UObject*>* ud = reinterpret_cast<UserData<UObject*>*>(luaL_checkudata(L, p,"UObject"));
@@ -382,7 +448,7 @@ namespace slua {
 		static int push(lua_State* L, const char* fn, const T* v, uint32 flag = UD_NOFLAG) {
             if(getFromCache(L,void_cast(v),fn)) return 1;
 			NewUD(T, v, flag);
-            luaL_getmetatable(L,fn);
+            pushMetatable(L,fn);
 			lua_setmetatable(L, -2);
             cacheObj(L,void_cast(v));
             return 1;
@@ -395,7 +461,7 @@ namespace slua {
 		static int pushAndLink(lua_State* L, const void* parent, const char* tn, const T* v) {
 			if (getFromCache(L, void_cast(v), tn)) return 1;
 			NewUD(T, v, UD_NOFLAG);
-			luaL_getmetatable(L, tn);
+			pushMetatable(L, tn);
 			lua_setmetatable(L, -2);
 			cacheObj(L, void_cast(v));
 			linkProp(L, void_cast(parent), void_cast(udptr));
@@ -411,7 +477,7 @@ namespace slua {
                 return 1;
             }
             UserData<T>* ud = reinterpret_cast< UserData<T>* >(lua_newuserdata(L, sizeof(UserData<T>)));
-			ud->parent = nullptr;
+			InitUDLink(ud);
             ud->ud = cls;
             ud->flag = gc!=nullptr?UD_AUTOGC:UD_NOFLAG;
 			if (F) ud->flag |= UD_UOBJECT;
@@ -439,7 +505,7 @@ namespace slua {
 			}
 			using BOXPUD = SharedPtrUD<T, mode>;
 			UserData<BOXPUD*>* ud = reinterpret_cast<UserData<BOXPUD*>*>(lua_newuserdata(L, sizeof(UserData<BOXPUD*>)));
-			ud->parent = nullptr;
+			InitUDLink(ud);
 			ud->ud = cls;
 			ud->flag = UD_AUTOGC|UD_SHAREDPTR;
 			if (F) ud->flag |= UD_UOBJECT;
@@ -567,6 +633,27 @@ namespace slua {
 			return LuaMap::push(L, v);
 		}
 
+		template<typename T>
+		static int push(lua_State* L, const TSet<T>& v) {
+			return LuaSet::push(L, v);
+		}
+
+		// push temporary container by move
+		template<typename T>
+		static int push(lua_State* L, TArray<T>&& v) {
+			return LuaArray::push(L, MoveTemp(v));
+		}
+
+		template<typename K,typename V>
+		static int push(lua_State* L, TMap<K,V>&& v) {
+			return LuaMap::push(L, MoveTemp(v));
+		}
+
+		template<typename T>
+		static int push(lua_State* L, TSet<T>&& v) {
+			return LuaSet::push(L, MoveTemp(v));
+		}
+
 		// static int push(lua_State* L, FScriptArray* array);
         
         static int pushNil(lua_State* L) {
@@ -594,6 +681,7 @@ namespace slua {
         static int gcStructClass(lua_State* L);
 		static int gcStruct(lua_State* L);
         static int objectToString(lua_State* L);
+        static int lazyGlobalIndex(lua_State* L);
         static void setupMetaTable(lua_State* L,const char* tn,lua_CFunction setupmt,lua_CFunction gc);
 		static void setupMetaTable(lua_State* L, const char* tn, lua_CFunction setupmt, int gc);
 		static void setupMetaTable(lua_State* L, const char* tn, lua_CFunction gc);
@@ -606,7 +694,7 @@ namespace slua {
             }
                 
             UserData<T>* ud = reinterpret_cast< UserData<T>* >(lua_newuserdata(L, sizeof(UserData<T>)));
-			ud->parent = nullptr;
+			InitUDLink(ud);
             ud->ud = cls;
             ud->flag = F|UD_AUTOGC;
 			if (F) ud->flag |= UD_UOBJECT;
@@ -0,0 +1,28 @@
+// Tencent is pleased to support the open source community by making sluaunreal available.
+
+// Copyright (C) 2018 THL A29 Limited, a Tencent company. All rights reserved.
+// Licensed under the BSD 3-Clause License (the "License");
+// you may not use this file except in compliance with the License. You may obtain a copy of the License at
+
+// https://opensource.org/licenses/BSD-3-Clause
+
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and limitations under the License.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "LuaPackCommandlet.generated.h"
+
+// pack lua files to one archive mounted by LuaState::mountArchive, run by
+// UE4Editor-Cmd <Project> -run=LuaPack [-Source=<dir>] [-Output=<file>] [-Compress]
+// Source default to Content/Lua, Output default to Content/Lua.slpk
+UCLASS()
+class SLUA_UNREAL_API ULuaPackCommandlet : public UCommandlet {
+	GENERATED_BODY()
+public:
+	virtual int32 Main(const FString& Params) override;
+};
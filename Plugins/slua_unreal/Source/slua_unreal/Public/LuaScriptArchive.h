@@ -0,0 +1,89 @@
+// Tencent is pleased to support the open source community by making sluaunreal available.
+
+// Copyright (C) 2018 THL A29 Limited, a Tencent company. All rights reserved.
+// Licensed under the BSD 3-Clause License (the "License");
+// you may not use this file except in compliance with the License. You may obtain a copy of the License at
+
+// https://opensource.org/licenses/BSD-3-Clause
+
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and limitations under the License.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Templates/UniquePtr.h"
+
+class IMappedFileHandle;
+class IMappedFileRegion;
+
+namespace slua {
+
+	// content of a lua file, points to mapped archive without copy,
+	// or owns memory of decompressed file or file read by load delegation
+	struct SLUA_UNREAL_API LuaScriptBuffer {
+		const uint8* data = nullptr;
+		uint32 len = 0;
+		FString filepath;
+		TUniquePtr<uint8[]> owned;
+		// file found in mounted archive, filepath is virtual and never changes
+		bool archived = false;
+	};
+
+	// lua sources and bytecode packed in one file, mapped to memory once and
+	// indexed by hash of module name, layout:
+	//   Header, Entry[count] sorted by hash, module names, file contents
+	class SLUA_UNREAL_API LuaScriptArchive {
+	public:
+		// map archive at path, return nullptr if it's missing or broken
+		static TSharedPtr<LuaScriptArchive, ESPMode::ThreadSafe> open(const FString& path);
+		// pack *.lua and *.luac under srcDir to archive at dstPath, module name is
+		// relative path without extension joined by '.', compressed by zlib if compress
+		static bool pack(const FString& srcDir, const FString& dstPath, bool compress);
+
+		~LuaScriptArchive();
+
+		// find file of module, compressed file is decompressed on demand, safe to call from any thread
+		bool find(const char* module, LuaScriptBuffer& out) const;
+		int32 num() const { return count; }
+
+	private:
+		LuaScriptArchive() = default;
+		bool init();
+
+		struct Header {
+			uint32 magic;
+			uint32 version;
+			uint32 count;
+			uint32 reserved;
+		};
+		struct Entry {
+			uint64 hash;
+			uint32 nameOffset;
+			uint32 nameLen;
+			uint32 offset;
+			uint32 size;
+			// size after decompressed
+			uint32 rawSize;
+			uint32 flags;
+		};
+		enum EntryFlag {
+			Compressed = 1,
+			Bytecode = 2,
+		};
+
+		FString path;
+		IMappedFileHandle* mappedFile = nullptr;
+		IMappedFileRegion* mappedRegion = nullptr;
+		// whole file read to memory if platform can't map file
+		TArray<uint8> fileData;
+		const uint8* data = nullptr;
+		int64 size = 0;
+		const Entry* entries = nullptr;
+		int32 count = 0;
+	};
+
+	typedef TSharedPtr<LuaScriptArchive, ESPMode::ThreadSafe> LuaScriptArchivePtr;
+}
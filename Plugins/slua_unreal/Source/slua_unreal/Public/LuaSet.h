@@ -0,0 +1,113 @@
+// Tencent is pleased to support the open source community by making sluaunreal available.
+
+// Copyright (C) 2018 THL A29 Limited, a Tencent company. All rights reserved.
+// Licensed under the BSD 3-Clause License (the "License"); 
+// you may not use this file except in compliance with the License. You may obtain a copy of the License at
+
+// https://opensource.org/licenses/BSD-3-Clause
+
+// Unless required by applicable law or agreed to in writing, 
+// software distributed under the License is distributed on an "AS IS" BASIS, 
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. 
+// See the License for the specific language governing permissions and limitations under the License.
+
+#pragma once
+#include "CoreMinimal.h"
+#include "lua/lua.hpp"
+#include "UObject/UnrealType.h"
+#include "UObject/GCObject.h"
+#include "Runtime/Launch/Resources/Version.h"
+#include "PropertyUtil.h"
+
+namespace slua {
+
+	template <typename T>
+	struct TIsTSet { enum { Value = false }; };
+
+	template<typename ElementType, typename KeyFuncs, typename Allocator>
+	struct TIsTSet<TSet<ElementType, KeyFuncs, Allocator>> { enum { Value = true }; };
+	template<typename ElementType, typename KeyFuncs, typename Allocator>
+	struct TIsTSet<const TSet<ElementType, KeyFuncs, Allocator>> { enum { Value = true }; };
+
+    class SLUA_UNREAL_API LuaSet : public FGCObject {
+    public:
+        static void reg(lua_State* L);
+        static void clone(FScriptSet* dest, UProperty* p, const FScriptSet* src);
+		// if byMove is true, set is a temporary, its storage is moved to the pushed LuaSet
+		static int push(lua_State* L, UProperty* prop, FScriptSet* set, bool byMove = false);
+		static int push(lua_State* L, USetProperty* prop, UObject* obj);
+
+		template<typename T>
+		static int push(lua_State* L, const TSet<T>& v) {
+			UProperty* prop = PropertyProto::getProperty(PropertyProto::get<T>());
+			auto set = reinterpret_cast<const FScriptSet*>(&v);
+			return push(L, prop, const_cast<FScriptSet*>(set));
+		}
+
+		template<typename T>
+		static int push(lua_State* L, TSet<T>&& v) {
+			UProperty* prop = PropertyProto::getProperty(PropertyProto::get<T>());
+			return push(L, prop, reinterpret_cast<FScriptSet*>(&v), true);
+		}
+
+		// add elements of lua table at p to set by helper, table index begin from 1
+		static void fillFromTable(lua_State* L, int p, FScriptSetHelper& helper);
+
+		LuaSet(UProperty* prop, FScriptSet* buf, bool byMove = false);
+		LuaSet(USetProperty* prop, UObject* obj);
+        ~LuaSet();
+
+        const FScriptSet* get() {
+            return set;
+        }
+
+        // move storage to dest if marked by set:Move(), otherwise copy elements to dest
+        void moveOrClone(UProperty* destInner, FScriptSet* dest);
+
+        // Cast FScriptSet to TSet<T> if ElementSize matched
+        template<typename T>
+        const TSet<T>& asTSet(lua_State* L) const {
+            if(sizeof(T)!=inner->ElementSize)
+                luaL_error(L,"Cast to TSet error, element size isn't mathed(%d,%d)",sizeof(T),inner->ElementSize);
+			static_assert(sizeof(FScriptSet) == sizeof(TSet<T>), "FScriptSet's size doesn't match TSet");
+            return *(reinterpret_cast<const TSet<T>*>( set ));
+        }
+
+        virtual void AddReferencedObjects( FReferenceCollector& Collector ) override;
+
+#if (ENGINE_MINOR_VERSION>=20) && (ENGINE_MAJOR_VERSION>=4)
+        virtual FString GetReferencerName() const override
+        {
+            return "LuaSet";
+        }
+#endif
+
+    protected:
+        static int __ctor(lua_State* L);
+        static int FromTable(lua_State* L);
+        static int ToTable(lua_State* L);
+        static int Num(lua_State* L);
+        static int Contains(lua_State* L);
+        static int Add(lua_State* L);
+        static int Remove(lua_State* L);
+        static int Clear(lua_State* L);
+        static int Move(lua_State* L);
+		static int Pairs(lua_State* L);
+		static int Enumerable(lua_State* L);
+		static int __len(lua_State* L);
+
+    private:
+        UProperty* inner;
+        FScriptSet* set;
+		USetProperty* prop;
+		UObject* propObj;
+		FScriptSetHelper helper;
+		bool movable;
+
+        void clear();
+        int32 findIndex(lua_State* L, int p);
+
+        static int setupMT(lua_State* L);
+        static int gc(lua_State* L);
+    };
+}
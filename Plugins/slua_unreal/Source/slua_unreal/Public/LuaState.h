@@ -16,16 +16,21 @@
 #include "CoreMinimal.h"
 #include "Components/SceneComponent.h"
 #include "LuaVar.h"
+#include "LuaScriptArchive.h"
 #include <string>
 #include <memory>
 #include <atomic>
 #include "HAL/Runnable.h"
+#include "Containers/Ticker.h"
+#include "Containers/Queue.h"
 
 #define SLUA_LUACODE "[sluacode]"
 #define SLUA_CPPINST "__cppinst"
 
 namespace slua {
 
+	class LuaCoroutineScheduler;
+
 	struct ScriptTimeoutEvent {
 		virtual void onTimeout() = 0;
 	};
@@ -59,9 +64,44 @@ namespace slua {
 		void onTimeout() override;
 	private:
 		lua_State* L;
+		LuaState* ls;
 		static void scriptTimeout(lua_State *L, lua_Debug *ar);
 	};
 
+	// run lua incremental gc once per frame within a time budget,
+	// step size adapts to allocation rate and memory headroom
+	class SLUA_UNREAL_API LuaGCScheduler {
+	public:
+		struct Stats {
+			// time spent in gc steps last frame, in milliseconds
+			double stepTime;
+			// count of gc steps last frame
+			int stepCount;
+			// bytes freed by gc steps last frame
+			int64 freedBytes;
+			// allocated KB not yet paid by gc steps
+			int debtKB;
+			// lua memory in KB after gc steps
+			int memoryKB;
+		};
+
+		LuaGCScheduler();
+
+		// time budget per frame in milliseconds, 0 to disable scheduled gc
+		float budgetMs;
+		// soft limit of lua memory in KB, step size grows when memory approaches it, 0 for no limit
+		int memoryLimitKB;
+
+		void reset(lua_State* L);
+		void tick(lua_State* L);
+		const Stats& stats() const { return lastStats; }
+	private:
+		int stepKB;
+		int debtKB;
+		int64 lastBytes;
+		Stats lastStats;
+	};
+
 	typedef TMap<UObject*, GenericUserData*> UObjectRefMap;
 
     class SLUA_UNREAL_API LuaState 
@@ -98,6 +138,9 @@ namespace slua {
         
         // return state index
         int stateIndex() const { return si; }
+
+        // return handle of state, it's invalid after state closed
+        LuaStateHandle handle() const { return LuaStateHandle(slot); }
         
         // init lua state
         virtual bool init(bool enableMultiThreadGC=false);
@@ -106,6 +149,11 @@ namespace slua {
         // close lua state
         virtual void close();
 
+        // gc scheduler driven by core ticker once per frame, set budget and read stats by it
+        LuaGCScheduler& gcScheduler() { return gcSched; }
+        // coroutine scheduler of slua.wait, slua.waitFrames, slua.waitUntil and latent function
+        LuaCoroutineScheduler* coroutineScheduler() const { return coScheduler; }
+
         // execute lua string
         LuaVar doString(const char* str, LuaVar* pEnv = nullptr);
         // execute bytes buffer and named buffer to chunk
@@ -114,6 +162,9 @@ namespace slua {
         // file how to loading depend on load delegation
         // see setLoadFileDelegate function
         LuaVar doFile(const char* fn, LuaVar* pEnv = nullptr);
+        // read and compile modules on worker threads, later require or doFile of them
+        // load compiled bytecode from memory, load delegation must be thread safe to preload
+        void preloadModules(const TArray<FString>& modules);
 
        
         // call function that specified by key
@@ -128,9 +179,19 @@ namespace slua {
         LuaVar get(const char* key);
 		// set field to _G, support "x.x.x.x" to create sub table recursive
 		bool set(const char* key, LuaVar v);
+		// same as get, but value of path is cached until lua file loaded or set called,
+		// changes made by running lua code aren't seen until clearResolveCache called
+		LuaVar resolve(const FString& key);
+		void clearResolveCache() { resolveCache.Empty(); }
 
         // set load delegation function to load lua code
 		void setLoadFileDelegate(LoadFileDelegate func);
+		// mount archive packed by LuaPack commandlet, files in archives are searched before
+		// load delegation and loaded from mapped memory, last mounted archive searched first
+		bool mountArchive(const FString& path);
+		// load files by cached bytecode of them if possible, see LuaBytecodeCache,
+		// enabled by default except in editor
+		void setBytecodeCache(bool enable) { bytecodeCache = enable; }
 
 		lua_State* getLuaState() const
 		{
@@ -163,7 +224,16 @@ namespace slua {
         static int pushErrorHandler(lua_State* L);
     protected:
         LoadFileDelegate loadFileDelegate;
-        uint8* loadFile(const char* fn,uint32& len,FString& filepath);
+        TArray<LuaScriptArchivePtr> archives;
+        // values of path got by resolve
+        TMap<FString, LuaVar> resolveCache;
+        bool loadFile(const char* fn,LuaScriptBuffer& out);
+        // read file from archives, then by load delegation, safe to call from any thread
+        static bool readFile(const TArray<LuaScriptArchivePtr>& archives,LoadFileDelegate delegate,const char* fn,LuaScriptBuffer& out);
+		// load file content as chunk to top of stack, return status of luaL_loadbuffer
+		int loadChunk(const uint8* buf,uint32 len,const char* chunk);
+		// load chunk of fn compiled by preloadModules to top of stack if exists
+		bool loadPreloaded(const char* fn);
 		static int loader(lua_State* L);
 		static int getStringFromMD5(lua_State* L);
     private:
@@ -173,21 +243,22 @@ namespace slua {
 		friend class LuaScriptCallGuard;
         lua_State* L;
         int cacheObjRef;
+        // ref of error handler function, pushed before each protected call
+        int errorRef;
 		// init enums lua code
         int _pushErrorHandler(lua_State* L);
         static int _atPanic(lua_State* L);
-		void linkProp(void* parent, void* prop);
-		void releaseLink(void* prop);
-		void releaseAllLink();
 		// unreal gc will call this funciton
 		void onEngineGC();
 		// on world cleanup
 		void onWorldCleanup(UWorld* World, bool bSessionEnded, bool bCleanupResources);
+		// core ticker callback, run scheduled gc
+		bool onTick(float dtime);
 
 
-		TMap<void*, TArray<void*>> propLinks;
         int stackCount;
         int si;
+        LuaStateSlot* slot;
         FString stateName;
 
 		// cache ufunction ptr if index by lua
@@ -211,8 +282,30 @@ namespace slua {
 
 		FDelegateHandle pgcHandler;
 		FDelegateHandle wcHandler;
+		FDelegateHandle tickHandler;
+
+		LuaGCScheduler gcSched;
+		LuaCoroutineScheduler* coScheduler;
 
 		bool enableMultiThreadGC;
+		bool bytecodeCache;
+
+		// module compiled by worker thread, bytecode is empty if failed
+		struct PreloadedChunk {
+			FString module;
+			FString filepath;
+			// modified time of file when read, only recorded for editor to reload changed file
+			FDateTime timestamp;
+			bool watched = false;
+			TArray<uint8> bytecode;
+		};
+		typedef TSharedPtr<PreloadedChunk, ESPMode::ThreadSafe> PreloadedChunkPtr;
+		typedef TQueue<PreloadedChunkPtr, EQueueMode::Mpsc> PreloadQueue;
+		// shared with worker threads, they may finish after state closed
+		TSharedPtr<PreloadQueue, ESPMode::ThreadSafe> preloadQueue;
+		TSet<FString> pendingPreloads;
+		TMap<FString, PreloadedChunkPtr> preloadedChunks;
+		static bool isStale(const PreloadedChunk& chunk);
 
         static LuaState* mainState;
 
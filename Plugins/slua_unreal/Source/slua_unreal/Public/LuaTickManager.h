@@ -0,0 +1,68 @@
+// Tencent is pleased to support the open source community by making sluaunreal available.
+
+// Copyright (C) 2018 THL A29 Limited, a Tencent company. All rights reserved.
+// Licensed under the BSD 3-Clause License (the "License");
+// you may not use this file except in compliance with the License. You may obtain a copy of the License at
+
+// https://opensource.org/licenses/BSD-3-Clause
+
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and limitations under the License.
+
+#pragma once
+#include "CoreMinimal.h"
+#include "Engine/EngineBaseTypes.h"
+#include "LuaVar.h"
+
+namespace slua {
+
+	class LuaState;
+	class LuaBase;
+	class LuaTickManager;
+
+	struct FLuaTickFunction : public FTickFunction {
+		LuaTickManager* manager = nullptr;
+
+		virtual void ExecuteTick(float DeltaTime, ELevelTick TickType, ENamedThreads::Type CurrentThread, const FGraphEventRef& MyCompletionGraphEvent) override;
+		virtual FString DiagnosticMessage() override;
+	};
+
+	// tick lua actors of one state and tick group in a world by one lua call per frame,
+	// actor opt in by bBatchTick field of its lua table, TickInterval field set tick interval in seconds
+	class SLUA_UNREAL_API LuaTickManager {
+	public:
+		// get manager of state and tick group in world, create it if not exists
+		static LuaTickManager* get(LuaState* ls, UWorld* world, ETickingGroup group);
+		// delete managers of state in world, delete all managers of state if world is nullptr
+		static void cleanup(LuaState* ls, UWorld* world);
+
+		void add(LuaBase* base, float interval);
+		void remove(LuaBase* base);
+		void tick(float deltaTime);
+
+	private:
+		LuaTickManager(LuaState* ls, UWorld* world, ETickingGroup group);
+		~LuaTickManager();
+
+		struct Entry {
+			LuaBase* base;
+			// 0 for tick every frame
+			float interval;
+			// delta time accumulated since last tick
+			float accum;
+		};
+
+		LuaStateHandle stateHandle;
+		TArray<Entry> entries;
+		// function(selves, deltas, n, errhandler) call Tick of selves[1..n]
+		LuaVar dispatcher;
+		// packed self tables and delta times reused each frame
+		LuaVar selves;
+		LuaVar deltas;
+		int lastCount;
+		bool ticking;
+		FLuaTickFunction tickFunction;
+	};
+}
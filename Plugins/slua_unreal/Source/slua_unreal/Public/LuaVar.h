@@ -28,6 +28,28 @@
 
 namespace slua {
 
+    class LuaState;
+
+    // slot of LuaState is never freed and reused by next state,
+    // generation is increased when state closed, so stale handle can be detected
+    struct LuaStateSlot {
+        LuaState* state;
+        uint32 generation;
+    };
+
+    // handle to LuaState, resolved by one pointer load and generation compare
+    struct LuaStateHandle {
+        LuaStateSlot* slot;
+        uint32 generation;
+
+        LuaStateHandle() :slot(nullptr), generation(0) {}
+        LuaStateHandle(LuaStateSlot* s) :slot(s), generation(s ? s->generation : 0) {}
+
+        LuaState* get() const {
+            return slot && slot->generation == generation ? slot->state : nullptr;
+        }
+    };
+
     class SLUA_UNREAL_API LuaVar {
     public:
         enum Type {LV_NIL,LV_INT,LV_NUMBER,LV_BOOL,
@@ -93,6 +115,7 @@ namespace slua {
         int64 asInt64() const;
         float asFloat() const;
         double asDouble() const;
+        // string from lua is empty after its state closed
         const char* asString(size_t* outlen=nullptr) const;
 		LuaLString asLString() const;
         bool asBool() const;
@@ -232,6 +255,9 @@ namespace slua {
     private:
         friend class LuaState;
 
+        // remove cached call plans of freed UFunctions, called after engine gc
+        static void removeStaleCallPlans();
+
         // used to create number n of tuple
         LuaVar(lua_State* L,size_t n);
 
@@ -270,33 +296,31 @@ namespace slua {
 			size_t length;
         };
 
-        struct RefRef: public Ref {
-            RefRef(lua_State* l);
-            virtual ~RefRef();
-            bool isValid() {
-                return ref != LUA_NOREF;
-            }
-            void push(lua_State* l) {
-                lua_geti(l,LUA_REGISTRYINDEX,ref);
-            }
-            int ref;
-            int stateIndex;
-        };
+        LuaStateHandle stateHandle;
 
-        int stateIndex;
+        // string from lua is referenced in registry, buf is valid until ref released and state closed
+        struct LuaStr {
+            const char* buf;
+            size_t length;
+        };
 
         typedef struct {
             union {
-                RefRef* ref;
                 lua_Integer i;
                 lua_Number d;
                 RefStr* s;
+                LuaStr ls;
                 void* ptr;
                 bool b;
             };
+            // registry ref of function/table/userdata and string from lua, otherwise LUA_NOREF
+            int ref;
             Type luatype;
         } lua_var;
 
+        // single value is stored in inlineVar, vars point to it,
+        // only tuple allocate vars array
+        lua_var inlineVar;
         lua_var* vars;
         size_t numOfVar;
     
@@ -322,11 +346,11 @@ namespace slua {
         }
 
         int docall(int argn) const;
-        int pushArgByParms(UProperty* prop,uint8* parms);
 
         void clone(const LuaVar& other);
         void move(LuaVar&& other);
         void varClone(lua_var& tv,const lua_var& ov) const;
+        void varRef(lua_State* l,lua_var& tv,int p,Type t);
         void pushVar(lua_State* l,const lua_var& ov) const;
     };
 
@@ -93,6 +93,9 @@ namespace slua {
         // create UProperty by PropertyProto
         // returned UProperty should be collect by yourself
         static UProperty* createProperty(const PropertyProto& p);
+        // get UProperty by PropertyProto, which is created once for each (type,cls) and rooted,
+        // returned UProperty is shared, don't modify or collect it
+        static UProperty* getProperty(const PropertyProto& p);
     }; 
 
     
@@ -17,10 +17,15 @@
 #include "LuaObject.h"
 #include "LuaState.h"
 #include "LuaVar.h"
+#include "LuaFunction.h"
 #include "LuaArray.h"
 #include "LuaMap.h"
+#include "LuaSet.h"
 #include "LuaBase.h"
 #include "LuaActor.h"
+#include "LuaTickManager.h"
+#include "LuaCoroutine.h"
+#include "LuaAsyncLoader.h"
 #include "LuaDelegate.h"
 #include "LuaCppBinding.h"
 #include "LuaCppBindingPost.h"
\ No newline at end of file
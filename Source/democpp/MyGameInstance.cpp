@@ -55,6 +55,14 @@ void UMyGameInstance::Init()
 
 		return nullptr;
 	});
+
+	// packed by LuaPack commandlet, files in it are loaded without ReadFile,
+	// editor loads edited sources by ReadFile instead
+	if (!GIsEditor)
+		state.mountArchive(FPaths::ProjectContentDir() / TEXT("Lua.slpk"));
+
+	// compile scripts used by test actor in background, ReadFile above is thread safe
+	state.preloadModules({ TEXT("Test"), TEXT("TestMap"), TEXT("TestActor") });
 }
 
 void UMyGameInstance::Shutdown()